@@ -9,6 +9,7 @@
 **/
 
 #include <IndustryStandard/Acpi.h>            // EFI_ACPI_DESCRIPTION_HEADER
+#include <IndustryStandard/AcpiAml.h>         // AML_NAME_OP
 #include <IndustryStandard/QemuLoader.h>      // QEMU_LOADER_FNAME_SIZE
 #include <IndustryStandard/UefiTcgPlatform.h>
 #include <Library/AcpiPlatformLib.h>
@@ -16,342 +17,644 @@
 #include <Library/BaseMemoryLib.h>            // CopyMem()
 #include <Library/DebugLib.h>                 // DEBUG()
 #include <Library/MemoryAllocationLib.h>      // AllocatePool()
-#include <Library/OrderedCollectionLib.h>     // OrderedCollectionMin()
 #include <Library/QemuFwCfgLib.h>             // QemuFwCfgFindFile()
 #include <Library/QemuFwCfgS3Lib.h>           // QemuFwCfgS3Enabled()
+#include <Library/TimerLib.h>                 // GetPerformanceCounter()
 #include <Library/UefiBootServicesTableLib.h> // gBS
 #include <Library/TpmMeasurementLib.h>
 #include "vrom.h"
-#include "vrom_table.h"
 
 //
-// The user structure for the ordered collection that will track the fw_cfg
-// blobs under processing.
+// The VBIOS image is exposed to the guest OS through a SystemMemory
+// OperationRegion ("VBOR") in an additional SSDT. PCI option ROM images come
+// in 512-byte units, so the region covers the image rounded up to that
+// granularity. The region lives in reserved memory for the lifetime of the
+// guest OS; VROM_REGION_MAX_SIZE (which can be overridden at build time, for
+// example with "-D VROM_REGION_MAX_SIZE=0x20000" in the DSC [BuildOptions])
+// caps how much memory it may take. An image that does not fit under the cap
+// is not exposed at all, since a truncated option ROM is of no use.
+//
+#define VROM_REGION_ALIGNMENT  512
+
+#ifndef VROM_REGION_MAX_SIZE
+#define VROM_REGION_MAX_SIZE  SIZE_256KB
+#endif
+
+//
+// The address of the region is an Integer in the SSDT. The width of AML
+// Integers follows the ComplianceRevision of the DSDT, not of the SSDT, and
+// QEMU's DSDT has revision 1, which limits them to 32 bits. The region must
+// therefore lie below 4GB.
+//
+#define VROM_REGION_MAX_ADDRESS  MAX_UINT32
+
+//
+// If QEMU offers a VBIOS image in this fw_cfg file (for example with
+// "-fw_cfg name=opt/vbios/rom,file=vbios.rom"), it takes precedence over the
+// VROM_BIN image that has been compiled in from vrom.h.
+//
+#define VROM_FW_CFG_FILE  "opt/vbios/rom"
+
+//
+// The ACPI path of the passed-through GPU, under which the SSDT places the
+// _ROM method that returns the VBIOS image. It depends on where the GPU sits
+// in the guest's PCI topology, so it can be overridden at build time with a
+// string such as "\\_SB.PCI0.S10".
+//
+#ifndef VROM_ACPI_DEVICE_PATH
+#define VROM_ACPI_DEVICE_PATH  "\\_SB.PCI0.S08"
+#endif
+
+//
+// InstallQemuFwCfgTables() always logs how long each of its phases took. With
+// PUBLISH_LOADER_STATS defined at build time, it also publishes the figures to
+// the guest OS, so that they can be scraped without a firmware log: an
+// OEM-specific ACPI table ("OEMQ") carries the address of a LOADER_STATS_RECORD
+// in reserved memory, which is filled in once the last phase has completed.
+//
+#ifdef PUBLISH_LOADER_STATS
+#define LOADER_STATS_PUBLISH  TRUE
+#else
+#define LOADER_STATS_PUBLISH  FALSE
+#endif
+
+//
+// The structure that tracks an fw_cfg blob under processing.
 //
 typedef struct {
-  UINT8      File[QEMU_LOADER_FNAME_SIZE]; // NUL-terminated name of the fw_cfg
-                                           // blob. This is the ordering / search
-                                           // key.
-  UINTN      Size;                         // The number of bytes in this blob.
-  UINT8      *Base;                        // Pointer to the blob data.
-  BOOLEAN    HostsOnlyTableData;           // TRUE iff the blob has been found to
-                                           // only contain data that is directly
-                                           // part of ACPI tables.
+  UINT8                   File[QEMU_LOADER_FNAME_SIZE]; // NUL-terminated name
+                                                        // of the fw_cfg blob.
+  UINTN                   Size;                         // The number of bytes
+                                                        // in this blob.
+  UINT8                   *Base;                        // Pointer to the blob
+                                                        // data.
+  FIRMWARE_CONFIG_ITEM    FwCfgItem;                    // The fw_cfg item to
+                                                        // download the blob
+                                                        // from.
+  UINT32                  Alignment;                    // Required alignment
+                                                        // of Base; a power of
+                                                        // two.
+  BOOLEAN                 Restricted32Bit;              // TRUE iff the blob
+                                                        // must not be
+                                                        // allocated from 64-bit
+                                                        // address space.
+  BOOLEAN                 HostsOnlyTableData;           // TRUE iff the blob has
+                                                        // been found to only
+                                                        // contain data that is
+                                                        // directly part of ACPI
+                                                        // tables.
+  UINTN                   ChecksummedEnd;               // The end of the
+                                                        // furthest range that
+                                                        // the first pass has
+                                                        // checksummed.
+  BOOLEAN                 ChecksumsStale;               // TRUE iff the first
+                                                        // pass has modified a
+                                                        // range after
+                                                        // checksumming it.
+  BOOLEAN                 Referenced;                   // TRUE iff an
+                                                        // AddPointer or
+                                                        // WritePointer command
+                                                        // refers to the blob.
+                                                        // Other blobs are only
+                                                        // read for measuring,
+                                                        // and get no memory.
 } BLOB;
 
+//
+// Decoded forms of the QEMU_LOADER_* commands. File names are replaced by
+// indices into the dense BLOB array (and, for QEMU_LOADER_WRITE_POINTER, by
+// the fw_cfg item of the file to write), and all checks that do not depend on
+// blob contents or addresses have been done by DecodeLoaderScript().
+//
+typedef struct {
+  UINT32    PointerBlob;
+  UINT32    PointeeBlob;
+  UINT32    PointerOffset;
+  UINT8     PointerSize;
+} LOADER_ADD_POINTER;
+
+typedef struct {
+  UINT32    Blob;
+  UINT32    ResultOffset;
+  UINT32    Start;
+  UINT32    Length;
+} LOADER_ADD_CHECKSUM;
+
+typedef struct {
+  UINT16    PointerItem;
+  UINT8     PointerSize;
+  UINT32    PointerOffset;
+  UINT32    PointeeBlob;
+  UINT32    PointeeOffset;
+} LOADER_WRITE_POINTER;
+
+typedef struct {
+  UINT32    Type;                     // QEMU_LOADER_COMMAND_TYPE, other than
+                                      // QemuLoaderCmdAllocate.
+  union {
+    LOADER_ADD_POINTER      AddPointer;
+    LOADER_ADD_CHECKSUM     AddChecksum;
+    LOADER_WRITE_POINTER    WritePointer;
+  } Command;
+} LOADER_COMMAND;
+
+//
+// A pointer write to an fw_cfg file, as recorded for replay at S3 resume.
+// Consecutive WritePointer commands that fill adjacent bytes of the same
+// fw_cfg file, up to 8 bytes in total, are coalesced into one such write, so
+// that the resume path issues one fw_cfg DMA transfer for them instead of one
+// per command. PointerSize is zero if no write has been recorded yet.
+//
+typedef struct {
+  UINT16    PointerItem;
+  UINT8     PointerSize;
+  UINT32    PointerOffset;
+  UINT64    PointerValue;
+} CONDENSED_WRITE;
+
+//
+// The blobs are sub-allocated from two AcpiNVS page ranges: one below 4GB for
+// the blobs that 32-bit pointers point into, and one for the rest.
+//
+typedef enum {
+  NvsArenaBelow4G,
+  NvsArenaAnywhere,
+  NvsArenaMax
+} NVS_ARENA_TYPE;
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    Base;
+  UINTN                   Pages;
+} NVS_ARENA;
+
+//
+// The decoded linker/loader script.
+//
+typedef struct {
+  LOADER_COMMAND         *Commands;          // The known commands, in script
+                                             // order. Allocate commands are
+                                             // represented by Blobs instead.
+  UINTN                  CommandCount;
+  BLOB                   *Blobs;             // One BLOB per Allocate command,
+                                             // in script order.
+  UINTN                  BlobCount;
+  UINT32                 *AddPointers;       // Indices into Commands of the
+                                             // AddPointer commands; that is,
+                                             // the list of pointer targets
+                                             // that the second pass examines.
+  UINTN                  AddPointerCount;
+  UINTN                  WritePointerCount;
+  UINTN                  CondensedWriteCount; // The number of
+                                              // CONDENSED_WRITEs that the
+                                              // WritePointer commands
+                                              // coalesce into.
+  LOADER_ADD_CHECKSUM    *SummedRanges;      // The AddChecksum commands that
+                                             // store the checksum inside the
+                                             // range they sum (so that the
+                                             // range sums to zero afterwards),
+                                             // sorted by blob, start and
+                                             // length.
+  UINTN                  SummedRangeCount;
+  NVS_ARENA              Arena[NvsArenaMax]; // Set by DownloadBlobs().
+} LOADER_SCRIPT;
+
+//
+// Buckets for the per-command accounting done by InstallQemuFwCfgTables().
+// The first four correspond to the QEMU_LOADER_COMMAND_TYPE values; the last
+// one covers the second pass, which installs the ACPI tables.
+//
+typedef enum {
+  LoaderStatAllocate,
+  LoaderStatAddPointer,
+  LoaderStatAddChecksum,
+  LoaderStatWritePointer,
+  LoaderStatInstallTables,
+  LoaderStatMax
+} LOADER_STAT_TYPE;
+
+typedef struct {
+  UINT32    Count;           // Number of commands processed.
+  UINT64    Ticks;           // Performance counter ticks spent processing.
+  UINT32    PageAllocations; // Number of gBS->AllocatePages() calls.
+  UINT64    Pages;           // Number of pages allocated.
+  UINT32    PoolAllocations; // Number of pool allocations.
+} LOADER_STAT;
+
+STATIC CONST CHAR8  *mLoaderStatName[LoaderStatMax] = {
+  "Allocate",
+  "AddPointer",
+  "AddChecksum",
+  "WritePointer",
+  "InstallTables"
+};
+
+STATIC LOADER_STAT  mLoaderStats[LoaderStatMax];
+
+//
+// The phases of InstallQemuFwCfgTables(), timed back to back. "Decode" includes
+// determining which blobs are restricted to 32-bit address space.
+//
+typedef enum {
+  LoaderPhaseReadScript,
+  LoaderPhaseDecode,
+  LoaderPhaseDownload,
+  LoaderPhaseFirstPass,
+  LoaderPhaseSecondPass,
+  LoaderPhaseVbiosSsdt,
+  LoaderPhaseInstallTables,
+  LoaderPhaseS3Transfer,
+  LoaderPhaseMax
+} LOADER_PHASE;
+
+STATIC CONST CHAR8  *mLoaderPhaseName[LoaderPhaseMax] = {
+  "ReadScript",
+  "Decode",
+  "Download",
+  "FirstPass",
+  "SecondPass",
+  "VbiosSsdt",
+  "InstallTables",
+  "S3Transfer"
+};
+
+STATIC UINT64  mLoaderPhaseTicks[LoaderPhaseMax];
+
+//
+// The number of bytes read from fw_cfg, and the number of ACPI tables
+// installed.
+//
+STATIC UINT64  mLoaderFwCfgBytes;
+STATIC UINTN   mLoaderTablesInstalled;
+
+#pragma pack (1)
+//
+// The record that LOADER_STATS_TABLE points to. All times are in nanoseconds.
+//
+typedef struct {
+  UINT32    Signature;                          // LOADER_STATS_SIGNATURE
+  UINT16    Length;                             // sizeof (LOADER_STATS_RECORD)
+  UINT16    PhaseCount;                         // LoaderPhaseMax
+  UINT64    PhaseTime[LoaderPhaseMax];          // In LOADER_PHASE order.
+  UINT64    FwCfgBytes;
+  UINT32    TablesInstalled;
+  UINT32    Reserved;
+} LOADER_STATS_RECORD;
+
+typedef struct {
+  EFI_ACPI_DESCRIPTION_HEADER    Header;
+  UINT64                         RecordAddress;
+} LOADER_STATS_TABLE;
+#pragma pack ()
+
+#define LOADER_STATS_SIGNATURE  SIGNATURE_32 ('Q', 'L', 'D', 'S')
+
+//
+// The number of times a QEMU_LOADER_ENTRY of the linker/loader script has been
+// read; that is, the script length times the number of passes over it.
+//
+STATIC UINTN  mLoaderEntryReads;
+
 /**
-  Compare a standalone key against a user structure containing an embedded key.
+  Map a QEMU_LOADER_COMMAND_TYPE value to its accounting bucket.
 
-  @param[in] StandaloneKey  Pointer to the bare key.
+  @param[in] Type  The Type field of a QEMU_LOADER_ENTRY.
 
-  @param[in] UserStruct     Pointer to the user structure with the embedded
-                            key.
+  @return  The LOADER_STAT tracking Type, or NULL if Type is unknown.
+**/
+STATIC
+LOADER_STAT *
+LoaderStatForCommand (
+  IN UINT32  Type
+  )
+{
+  switch (Type) {
+    case QemuLoaderCmdAllocate:
+      return &mLoaderStats[LoaderStatAllocate];
+    case QemuLoaderCmdAddPointer:
+      return &mLoaderStats[LoaderStatAddPointer];
+    case QemuLoaderCmdAddChecksum:
+      return &mLoaderStats[LoaderStatAddChecksum];
+    case QemuLoaderCmdWritePointer:
+      return &mLoaderStats[LoaderStatWritePointer];
+    default:
+      return NULL;
+  }
+}
 
-  @retval <0  If StandaloneKey compares less than UserStruct's key.
+/**
+  Account for the time spent in a phase of InstallQemuFwCfgTables(), and start
+  timing the next one.
 
-  @retval  0  If StandaloneKey compares equal to UserStruct's key.
+  @param[in] Phase           The phase that has just completed.
 
-  @retval >0  If StandaloneKey compares greater than UserStruct's key.
+  @param[in,out] PhaseStart  On input, the performance counter value at the
+                             start of Phase. On output, the current value.
 **/
 STATIC
-INTN
-/**
- * @brief Compares a standalone ASCII key string to the file name in a BLOB structure.
- *
- * @param StandaloneKey Pointer to a NUL-terminated ASCII string key.
- * @param UserStruct Pointer to a BLOB structure containing the file name.
- * @return INTN Zero if the keys match, a nonzero value otherwise.
- */
-EFIAPI
-BlobKeyCompare (
-  IN CONST VOID  *StandaloneKey,
-  IN CONST VOID  *UserStruct
+VOID
+LoaderPhaseEnd (
+  IN     LOADER_PHASE  Phase,
+  IN OUT UINT64        *PhaseStart
   )
 {
-  CONST BLOB  *Blob;
+  UINT64  Now;
 
-  Blob = UserStruct;
-  return AsciiStrCmp (StandaloneKey, (CONST CHAR8 *)Blob->File);
+  Now                       = GetPerformanceCounter ();
+  mLoaderPhaseTicks[Phase] += Now - *PhaseStart;
+  *PhaseStart               = Now;
 }
 
 /**
-  Comparator function for two user structures.
+  Log the per-command accounting collected while processing the linker/loader
+  script, so that boot-time regressions can be read off the firmware log.
+**/
+STATIC
+VOID
+ReportLoaderStats (
+  VOID
+  )
+{
+  LOADER_STAT_TYPE  Type;
+  LOADER_STAT       *Stat;
+  LOADER_PHASE      Phase;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: loader entry reads=%Lu\n",
+    __func__,
+    (UINT64)mLoaderEntryReads
+    ));
+
+  for (Type = 0; Type < LoaderStatMax; ++Type) {
+    Stat = &mLoaderStats[Type];
+    if (Stat->Count == 0) {
+      continue;
+    }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: %a: count=%u time=%Luns page-allocs=%u pages=%Lu "
+      "pool-allocs=%u\n",
+      __func__,
+      mLoaderStatName[Type],
+      Stat->Count,
+      GetTimeInNanoSecond (Stat->Ticks),
+      Stat->PageAllocations,
+      Stat->Pages,
+      Stat->PoolAllocations
+      ));
+  }
+
+  for (Phase = 0; Phase < LoaderPhaseMax; ++Phase) {
+    if (mLoaderPhaseTicks[Phase] == 0) {
+      continue;
+    }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: phase %a: time=%Luns\n",
+      __func__,
+      mLoaderPhaseName[Phase],
+      GetTimeInNanoSecond (mLoaderPhaseTicks[Phase])
+      ));
+  }
 
-  @param[in] UserStruct1  Pointer to the first user structure.
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: fw_cfg bytes read=%Lu tables installed=%Lu\n",
+    __func__,
+    mLoaderFwCfgBytes,
+    (UINT64)mLoaderTablesInstalled
+    ));
+}
 
-  @param[in] UserStruct2  Pointer to the second user structure.
+//
+// Name-to-index map for the fw_cfg blobs, used while decoding the linker/loader
+// script. The BLOBs live in a dense array, in the order of the
+// QEMU_LOADER_ALLOCATE commands that create them, so a blob's position in the
+// array is its integer index. The slot array is an open-addressing hash table
+// (with linear probing) over the names of the blobs; resolving a file name
+// thus costs one hash computation and, typically, one string comparison,
+// rather than a tree walk with a string comparison at each level.
+//
+typedef struct {
+  BLOB      *Blobs;    // The dense BLOB array.
+  UINT32    *Slots;    // Each slot holds (blob index + 1), or 0 if empty.
+  UINTN     SlotMask;  // The number of slots, minus one.
+} BLOB_INDEX;
 
-  @retval <0  If UserStruct1 compares less than UserStruct2.
+/**
+  Hash a NUL-terminated fw_cfg file name (32-bit FNV-1a).
 
-  @retval  0  If UserStruct1 compares equal to UserStruct2.
+  @param[in] Name  The file name to hash.
 
-  @retval >0  If UserStruct1 compares greater than UserStruct2.
+  @return  The hash value.
 **/
 STATIC
-INTN
-/**
- * @brief Compares two BLOB structures by their file name keys.
- *
- * This function compares the file name of the first BLOB structure to the file name of the second BLOB structure using ASCII string comparison.
- *
- * @param UserStruct1 Pointer to the first BLOB structure.
- * @param UserStruct2 Pointer to the second BLOB structure.
- * @return INTN Negative if UserStruct1's file name is less, zero if equal, positive if greater.
- */
-EFIAPI
-BlobCompare (
-  IN CONST VOID  *UserStruct1,
-  IN CONST VOID  *UserStruct2
+UINT32
+BlobNameHash (
+  IN CONST UINT8  *Name
   )
 {
-  CONST BLOB  *Blob1;
+  UINT32  Hash;
+
+  Hash = 0x811C9DC5;
+  while (*Name != '\0') {
+    Hash ^= *Name++;
+    Hash *= 0x01000193;
+  }
 
-  Blob1 = UserStruct1;
-  return BlobKeyCompare (Blob1->File, UserStruct2);
+  return Hash;
 }
 
 /**
-  Comparator function for two opaque pointers, ordering on (unsigned) pointer
-  value itself.
-  Can be used as both Key and UserStruct comparator.
-
-  @param[in] Pointer1  First pointer.
+  Locate the hash slot of a file name in a BLOB_INDEX.
 
-  @param[in] Pointer2  Second pointer.
+  @param[in] Tracker  The BLOB_INDEX to search.
 
-  @retval <0  If Pointer1 compares less than Pointer2.
+  @param[in] Name     The NUL-terminated file name to look for.
 
-  @retval  0  If Pointer1 compares equal to Pointer2.
-
-  @retval >0  If Pointer1 compares greater than Pointer2.
+  @return  The slot that holds Name, or the empty slot where Name would be
+           inserted.
 **/
 STATIC
-INTN
-/**
- * @brief Compares two pointers by their unsigned address values.
- *
- * @param Pointer1 First pointer to compare.
- * @param Pointer2 Second pointer to compare.
- * @return int Returns 0 if the pointers are equal, -1 if Pointer1 is less than Pointer2, or 1 if Pointer1 is greater than Pointer2.
- */
-EFIAPI
-PointerCompare (
-  IN CONST VOID  *Pointer1,
-  IN CONST VOID  *Pointer2
+UINT32 *
+BlobIndexSlot (
+  IN CONST BLOB_INDEX  *Tracker,
+  IN CONST UINT8       *Name
   )
 {
-  if (Pointer1 == Pointer2) {
-    return 0;
-  }
+  UINTN   SlotIndex;
+  UINT32  *Slot;
+
+  SlotIndex = BlobNameHash (Name) & Tracker->SlotMask;
+  for ( ; ;) {
+    Slot = &Tracker->Slots[SlotIndex];
+    if ((*Slot == 0) ||
+        (AsciiStrCmp (
+           (CONST CHAR8 *)Name,
+           (CONST CHAR8 *)Tracker->Blobs[*Slot - 1].File
+           ) == 0))
+    {
+      return Slot;
+    }
 
-  if ((UINTN)Pointer1 < (UINTN)Pointer2) {
-    return -1;
+    SlotIndex = (SlotIndex + 1) & Tracker->SlotMask;
   }
-
-  return 1;
 }
 
 /**
-  Comparator function for two ASCII strings. Can be used as both Key and
-  UserStruct comparator.
+  Initialize an empty BLOB_INDEX over a BLOB array.
 
-  This function exists solely so we can avoid casting &AsciiStrCmp to
-  ORDERED_COLLECTION_USER_COMPARE and ORDERED_COLLECTION_KEY_COMPARE.
+  @param[out] Tracker   The BLOB_INDEX to initialize.
 
-  @param[in] AsciiString1  Pointer to the first ASCII string.
+  @param[in] Blobs      The dense BLOB array. Ownership is not transferred.
 
-  @param[in] AsciiString2  Pointer to the second ASCII string.
+  @param[in] Capacity   The number of blobs that will be inserted at most.
 
-  @return  The return value of AsciiStrCmp (AsciiString1, AsciiString2).
+  @retval EFI_SUCCESS           Tracker has been initialized.
+
+  @retval EFI_OUT_OF_RESOURCES  Pool allocation failed.
 **/
 STATIC
-INTN
-/**
- * @brief Compares two ASCII strings for equality.
- *
- * Performs a case-sensitive comparison of two NUL-terminated ASCII strings.
- *
- * @return Zero if the strings are identical; a positive or negative value indicating the difference between the first differing characters otherwise.
- */
-EFIAPI
-AsciiStringCompare (
-  IN CONST VOID  *AsciiString1,
-  IN CONST VOID  *AsciiString2
+EFI_STATUS
+BlobIndexInit (
+  OUT BLOB_INDEX  *Tracker,
+  IN  BLOB        *Blobs,
+  IN  UINTN       Capacity
   )
 {
-  return AsciiStrCmp (AsciiString1, AsciiString2);
+  UINTN  SlotCount;
+
+  //
+  // Keep the load factor at or below one half.
+  //
+  SlotCount = 16;
+  while (SlotCount < 2 * Capacity) {
+    SlotCount *= 2;
+  }
+
+  Tracker->Slots = AllocateZeroPool (SlotCount * sizeof *Tracker->Slots);
+  if (Tracker->Slots == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  mLoaderStats[LoaderStatAllocate].PoolAllocations++;
+
+  Tracker->Blobs    = Blobs;
+  Tracker->SlotMask = SlotCount - 1;
+  return EFI_SUCCESS;
 }
 
-/**
- * @brief Releases all resources associated with a collection of 32-bit restricted allocations.
- *
- * Frees all entries and uninitializes the ORDERED_COLLECTION used to track blobs that must be allocated below 4GB.
- *
- * @param[in] AllocationsRestrictedTo32Bit The collection to release.
- */
+/**
+  Release the hash table of a BLOB_INDEX. The BLOB array is not freed.
+
+  @param[in] Tracker  The BLOB_INDEX to tear down.
+**/
 STATIC
 VOID
-ReleaseAllocationsRestrictedTo32Bit (
-  IN ORDERED_COLLECTION  *AllocationsRestrictedTo32Bit
+BlobIndexUninit (
+  IN BLOB_INDEX  *Tracker
   )
 {
-  ORDERED_COLLECTION_ENTRY  *Entry, *Entry2;
+  FreePool (Tracker->Slots);
+}
 
-  for (Entry = OrderedCollectionMin (AllocationsRestrictedTo32Bit);
-       Entry != NULL;
-       Entry = Entry2)
-  {
-    Entry2 = OrderedCollectionNext (Entry);
-    OrderedCollectionDelete (AllocationsRestrictedTo32Bit, Entry, NULL);
-  }
+/**
+  Make a blob known to a BLOB_INDEX.
 
-  OrderedCollectionUninit (AllocationsRestrictedTo32Bit);
-}
+  @param[in,out] Tracker  The BLOB_INDEX to insert into.
 
-/**
- * @brief Collects names of blobs requiring 32-bit address allocation from the loader script.
- *
- * Iterates over the QEMU loader script entries and identifies blobs referenced by QEMU_LOADER_ADD_POINTER commands with a pointer size less than 8 bytes. These blobs must be allocated below 4GB to ensure pointer patching is valid. The function populates an ORDERED_COLLECTION with the names of such blobs.
- *
- * @param[out] AllocationsRestrictedTo32Bit Receives a collection of blob names restricted to 32-bit allocation.
- * @param[in] LoaderStart Pointer to the first entry in the loader script.
- * @param[in] LoaderEnd Pointer one past the last entry in the loader script.
- *
- * @retval EFI_SUCCESS The collection was populated successfully.
- * @retval EFI_OUT_OF_RESOURCES Memory allocation failed.
- * @retval EFI_PROTOCOL_ERROR The loader script contains malformed entries.
- */
+  @param[in] BlobIndex    The index of the blob in Tracker->Blobs. The File
+                          field of the blob must have been set.
+
+  @retval EFI_SUCCESS         The blob has been inserted.
+
+  @retval EFI_PROTOCOL_ERROR  Another blob with the same name is known already.
+**/
 STATIC
 EFI_STATUS
-CollectAllocationsRestrictedTo32Bit (
-  OUT ORDERED_COLLECTION      **AllocationsRestrictedTo32Bit,
-  IN CONST QEMU_LOADER_ENTRY  *LoaderStart,
-  IN CONST QEMU_LOADER_ENTRY  *LoaderEnd
+BlobIndexInsert (
+  IN OUT BLOB_INDEX  *Tracker,
+  IN     UINTN       BlobIndex
   )
 {
-  ORDERED_COLLECTION       *Collection;
-  CONST QEMU_LOADER_ENTRY  *LoaderEntry;
-  EFI_STATUS               Status;
+  UINT32  *Slot;
 
-  Collection = OrderedCollectionInit (AsciiStringCompare, AsciiStringCompare);
-  if (Collection == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  Slot = BlobIndexSlot (Tracker, Tracker->Blobs[BlobIndex].File);
+  if (*Slot != 0) {
+    return EFI_PROTOCOL_ERROR;
   }
 
-  for (LoaderEntry = LoaderStart; LoaderEntry < LoaderEnd; ++LoaderEntry) {
-    CONST QEMU_LOADER_ADD_POINTER  *AddPointer;
+  *Slot = (UINT32)(BlobIndex + 1);
+  return EFI_SUCCESS;
+}
 
-    if (LoaderEntry->Type != QemuLoaderCmdAddPointer) {
-      continue;
-    }
+/**
+  Look up a blob by file name.
 
-    AddPointer = &LoaderEntry->Command.AddPointer;
+  @param[in] Tracker     The BLOB_INDEX to search.
 
-    if (AddPointer->PointerSize >= 8) {
-      continue;
-    }
+  @param[in] Name        The NUL-terminated file name to look for.
 
-    if (AddPointer->PointeeFile[QEMU_LOADER_FNAME_SIZE - 1] != '\0') {
-      DEBUG ((DEBUG_ERROR, "%a: malformed file name\n", __func__));
-      Status = EFI_PROTOCOL_ERROR;
-      goto RollBack;
-    }
+  @param[out] BlobIndex  On success, the index of the blob called Name.
 
-    Status = OrderedCollectionInsert (
-               Collection,
-               NULL,                           // Entry
-               (VOID *)AddPointer->PointeeFile
-               );
-    switch (Status) {
-      case EFI_SUCCESS:
-        DEBUG ((
-          DEBUG_VERBOSE,
-          "%a: restricting blob \"%a\" from 64-bit allocation\n",
-          __func__,
-          AddPointer->PointeeFile
-          ));
-        break;
-      case EFI_ALREADY_STARTED:
-        //
-        // The restriction has been recorded already.
-        //
-        break;
-      case EFI_OUT_OF_RESOURCES:
-        goto RollBack;
-      default:
-        ASSERT (FALSE);
-    }
+  @retval EFI_SUCCESS    The blob has been found.
+
+  @retval EFI_NOT_FOUND  No blob called Name has been inserted (that is,
+                         announced by a QEMU_LOADER_ALLOCATE command) yet.
+**/
+STATIC
+EFI_STATUS
+BlobIndexFind (
+  IN CONST BLOB_INDEX  *Tracker,
+  IN CONST UINT8       *Name,
+  OUT UINT32           *BlobIndex
+  )
+{
+  UINT32  Slot;
+
+  Slot = *BlobIndexSlot (Tracker, Name);
+  if (Slot == 0) {
+    return EFI_NOT_FOUND;
   }
 
-  *AllocationsRestrictedTo32Bit = Collection;
+  *BlobIndex = Slot - 1;
   return EFI_SUCCESS;
-
-RollBack:
-  ReleaseAllocationsRestrictedTo32Bit (Collection);
-  return Status;
 }
 
 /**
-  Process a QEMU_LOADER_ALLOCATE command.
+  Decode a QEMU_LOADER_ALLOCATE command into the next element of the BLOB
+  array.
 
-  @param[in] Allocate                      The QEMU_LOADER_ALLOCATE command to
-                                           process.
+  @param[in] Allocate     The QEMU_LOADER_ALLOCATE command to decode.
 
-  @param[in,out] Tracker                   The ORDERED_COLLECTION tracking the
-                                           BLOB user structures created thus
-                                           far.
+  @param[in,out] Tracker  The BLOB_INDEX tracking the blobs decoded thus far.
 
-  @param[in] AllocationsRestrictedTo32Bit  The ORDERED_COLLECTION populated by
-                                           the function
-                                           CollectAllocationsRestrictedTo32Bit,
-                                           naming the fw_cfg blobs that must
-                                           not be allocated from 64-bit address
-                                           space.
+  @param[in] BlobIndex    The index of the BLOB in Tracker->Blobs to populate.
 
-  @retval EFI_SUCCESS           An area of whole AcpiNVS pages has been
-                                allocated for the blob contents, and the
-                                contents have been saved. A BLOB object (user
-                                structure) has been allocated from pool memory,
-                                referencing the blob contents. The BLOB user
-                                structure has been linked into Tracker.
+  @retval EFI_SUCCESS         The blob has been located in fw_cfg and made
+                              known to Tracker.
 
-  @retval EFI_PROTOCOL_ERROR    Malformed fw_cfg file name has been found in
-                                Allocate, or the Allocate command references a
-                                file that is already known by Tracker.
-
-  @retval EFI_UNSUPPORTED       Unsupported alignment request has been found in
-                                Allocate.
+  @retval EFI_PROTOCOL_ERROR  Malformed fw_cfg file name has been found in
+                              Allocate, or the Allocate command references a
+                              file that is already known by Tracker.
 
-  @retval EFI_OUT_OF_RESOURCES  Pool allocation failed.
+  @retval EFI_UNSUPPORTED     Unsupported alignment request has been found in
+                              Allocate.
 
-  @return                       Error codes from QemuFwCfgFindFile() and
-                                gBS->AllocatePages().
+  @return                     Error codes from QemuFwCfgFindFile().
 **/
 STATIC
 EFI_STATUS
-/**
- * @brief Allocates memory for a fw_cfg blob and loads its data.
- *
- * Processes a QEMU_LOADER_ALLOCATE command by validating the file name and alignment, locating the corresponding fw_cfg file, allocating ACPI NVS memory (with 32-bit address restriction if required), reading the blob data from fw_cfg, and tracking the allocation. Returns an error if the input is malformed, the blob is duplicated, alignment is unsupported, or allocation fails.
- *
- * @param Allocate Pointer to the QEMU_LOADER_ALLOCATE command structure describing the allocation.
- * @param Tracker Collection tracking all allocated blobs.
- * @param AllocationsRestrictedTo32Bit Collection of blob names that must be allocated below 4GB.
- * @return EFI_STATUS EFI_SUCCESS on success, or error code on failure.
- */
-EFIAPI
-ProcessCmdAllocate (
-  IN CONST QEMU_LOADER_ALLOCATE  *Allocate,
-  IN OUT ORDERED_COLLECTION      *Tracker,
-  IN ORDERED_COLLECTION          *AllocationsRestrictedTo32Bit
+DecodeCmdAllocate (
+  IN     CONST QEMU_LOADER_ALLOCATE  *Allocate,
+  IN OUT BLOB_INDEX                  *Tracker,
+  IN     UINTN                       BlobIndex
   )
 {
-  FIRMWARE_CONFIG_ITEM  FwCfgItem;
-  UINTN                 FwCfgSize;
-  EFI_STATUS            Status;
-  UINTN                 NumPages;
-  EFI_PHYSICAL_ADDRESS  Address;
-  BLOB                  *Blob;
+  BLOB        *Blob;
+  EFI_STATUS  Status;
 
   if (Allocate->File[QEMU_LOADER_FNAME_SIZE - 1] != '\0') {
     DEBUG ((DEBUG_ERROR, "%a: malformed file name\n", __func__));
@@ -368,144 +671,85 @@ ProcessCmdAllocate (
     return EFI_UNSUPPORTED;
   }
 
-  Status = QemuFwCfgFindFile ((CHAR8 *)Allocate->File, &FwCfgItem, &FwCfgSize);
+  Blob = &Tracker->Blobs[BlobIndex];
+  CopyMem (Blob->File, Allocate->File, QEMU_LOADER_FNAME_SIZE);
+  Status = BlobIndexInsert (Tracker, BlobIndex);
   if (EFI_ERROR (Status)) {
     DEBUG ((
       DEBUG_ERROR,
-      "%a: QemuFwCfgFindFile(\"%a\"): %r\n",
+      "%a: duplicated file \"%a\"\n",
       __func__,
-      Allocate->File,
-      Status
+      Allocate->File
       ));
     return Status;
   }
 
-  NumPages = EFI_SIZE_TO_PAGES (FwCfgSize);
-  Address  = MAX_UINT64;
-  if (OrderedCollectionFind (
-        AllocationsRestrictedTo32Bit,
-        Allocate->File
-        ) != NULL)
-  {
-    Address = MAX_UINT32;
-  }
-
-  Status = gBS->AllocatePages (
-                  AllocateMaxAddress,
-                  EfiACPIMemoryNVS,
-                  NumPages,
-                  &Address
-                  );
+  Status = QemuFwCfgFindFile (
+             (CHAR8 *)Allocate->File,
+             &Blob->FwCfgItem,
+             &Blob->Size
+             );
   if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
-  Blob = AllocatePool (sizeof *Blob);
-  if (Blob == NULL) {
-    Status = EFI_OUT_OF_RESOURCES;
-    goto FreePages;
-  }
-
-  CopyMem (Blob->File, Allocate->File, QEMU_LOADER_FNAME_SIZE);
-  Blob->Size               = FwCfgSize;
-  Blob->Base               = (VOID *)(UINTN)Address;
-  Blob->HostsOnlyTableData = TRUE;
-
-  Status = OrderedCollectionInsert (Tracker, NULL, Blob);
-  if (Status == RETURN_ALREADY_STARTED) {
     DEBUG ((
       DEBUG_ERROR,
-      "%a: duplicated file \"%a\"\n",
+      "%a: QemuFwCfgFindFile(\"%a\"): %r\n",
       __func__,
-      Allocate->File
+      Allocate->File,
+      Status
       ));
-    Status = EFI_PROTOCOL_ERROR;
+    return Status;
   }
 
-  if (EFI_ERROR (Status)) {
-    goto FreeBlob;
+  //
+  // QEMU only ever requests power-of-two alignments; treat anything else as a
+  // request for a whole page.
+  //
+  Blob->Alignment = MAX (Allocate->Alignment, 1);
+  if ((Blob->Alignment & (Blob->Alignment - 1)) != 0) {
+    Blob->Alignment = EFI_PAGE_SIZE;
   }
 
-  QemuFwCfgSelectItem (FwCfgItem);
-  QemuFwCfgReadBytes (FwCfgSize, Blob->Base);
-  ZeroMem (Blob->Base + Blob->Size, EFI_PAGES_TO_SIZE (NumPages) - Blob->Size);
+  Blob->HostsOnlyTableData = TRUE;
 
   DEBUG ((
     DEBUG_VERBOSE,
-    "%a: File=\"%a\" Alignment=0x%x Zone=%d Size=0x%Lx "
-    "Address=0x%Lx\n",
+    "%a: File=\"%a\" Alignment=0x%x Zone=%d Size=0x%Lx\n",
     __func__,
     Allocate->File,
     Allocate->Alignment,
     Allocate->Zone,
-    (UINT64)Blob->Size,
-    (UINT64)(UINTN)Blob->Base
+    (UINT64)Blob->Size
     ));
-
-  //
-  // Measure the data which is downloaded from QEMU.
-  // It has to be done before it is consumed. Because the data will
-  // be updated in the following operations.
-  //
-  TpmMeasureAndLogData (
-    1,
-    EV_PLATFORM_CONFIG_FLAGS,
-    EV_POSTCODE_INFO_ACPI_DATA,
-    ACPI_DATA_LEN,
-    (VOID *)(UINTN)Blob->Base,
-    Blob->Size
-    );
-
   return EFI_SUCCESS;
-
-FreeBlob:
-  FreePool (Blob);
-
-FreePages:
-  gBS->FreePages (Address, NumPages);
-
-  return Status;
 }
 
 /**
-  Process a QEMU_LOADER_ADD_POINTER command.
+  Decode a QEMU_LOADER_ADD_POINTER command.
 
-  @param[in] AddPointer  The QEMU_LOADER_ADD_POINTER command to process.
+  @param[in] AddPointer  The QEMU_LOADER_ADD_POINTER command to decode.
 
-  @param[in] Tracker     The ORDERED_COLLECTION tracking the BLOB user
-                         structures created thus far.
+  @param[in] Tracker     The BLOB_INDEX tracking the blobs decoded thus far.
+                         The pointee blob is restricted to 32-bit address space
+                         if the pointer is narrower than 8 bytes.
+
+  @param[out] Decoded    The decoded command.
+
+  @retval EFI_SUCCESS         AddPointer has been decoded.
 
   @retval EFI_PROTOCOL_ERROR  Malformed fw_cfg file name(s) have been found in
                               AddPointer, or the AddPointer command references
                               a file unknown to Tracker, or the pointer to
-                              relocate has invalid location, size, or value, or
-                              the relocated pointer value is not representable
-                              in the given pointer size.
-
-  @retval EFI_SUCCESS         The pointer field inside the pointer blob has
-                              been relocated.
+                              relocate has invalid location or size.
 **/
 STATIC
 EFI_STATUS
-/**
- * @brief Relocates a pointer field within a blob to reference another blob's memory.
- *
- * Processes a QEMU_LOADER_ADD_POINTER command by updating a pointer field in the specified blob to point to the absolute address of another blob, offset by the original pointer value. Validates file names, pointer sizes, offsets, and ensures the relocated pointer is representable. Returns an error if any validation fails.
- *
- * @param AddPointer The loader command describing the pointer relocation.
- * @param Tracker The collection of blobs referenced by file name.
- * @return EFI_STATUS EFI_SUCCESS on success, or EFI_PROTOCOL_ERROR on malformed input or invalid references.
- */
-EFIAPI
-ProcessCmdAddPointer (
-  IN CONST QEMU_LOADER_ADD_POINTER  *AddPointer,
-  IN CONST ORDERED_COLLECTION       *Tracker
+DecodeCmdAddPointer (
+  IN  CONST QEMU_LOADER_ADD_POINTER  *AddPointer,
+  IN  CONST BLOB_INDEX               *Tracker,
+  OUT LOADER_ADD_POINTER             *Decoded
   )
 {
-  ORDERED_COLLECTION_ENTRY  *TrackerEntry, *TrackerEntry2;
-  BLOB                      *Blob, *Blob2;
-  UINT8                     *PointerField;
-  UINT64                    PointerValue;
+  BLOB  *Blob;
 
   if ((AddPointer->PointerFile[QEMU_LOADER_FNAME_SIZE - 1] != '\0') ||
       (AddPointer->PointeeFile[QEMU_LOADER_FNAME_SIZE - 1] != '\0'))
@@ -514,9 +758,21 @@ ProcessCmdAddPointer (
     return EFI_PROTOCOL_ERROR;
   }
 
-  TrackerEntry  = OrderedCollectionFind (Tracker, AddPointer->PointerFile);
-  TrackerEntry2 = OrderedCollectionFind (Tracker, AddPointer->PointeeFile);
-  if ((TrackerEntry == NULL) || (TrackerEntry2 == NULL)) {
+  if (EFI_ERROR (
+        BlobIndexFind (
+          Tracker,
+          AddPointer->PointerFile,
+          &Decoded->PointerBlob
+          )
+        ) ||
+      EFI_ERROR (
+        BlobIndexFind (
+          Tracker,
+          AddPointer->PointeeFile,
+          &Decoded->PointeeBlob
+          )
+        ))
+  {
     DEBUG ((
       DEBUG_ERROR,
       "%a: invalid blob reference(s) \"%a\" / \"%a\"\n",
@@ -527,8 +783,7 @@ ProcessCmdAddPointer (
     return EFI_PROTOCOL_ERROR;
   }
 
-  Blob  = OrderedCollectionUserStruct (TrackerEntry);
-  Blob2 = OrderedCollectionUserStruct (TrackerEntry2);
+  Blob = &Tracker->Blobs[Decoded->PointerBlob];
   if (((AddPointer->PointerSize != 1) && (AddPointer->PointerSize != 2) &&
        (AddPointer->PointerSize != 4) && (AddPointer->PointerSize != 8)) ||
       (Blob->Size < AddPointer->PointerSize) ||
@@ -543,95 +798,59 @@ ProcessCmdAddPointer (
     return EFI_PROTOCOL_ERROR;
   }
 
-  PointerField = Blob->Base + AddPointer->PointerOffset;
-  PointerValue = 0;
-  CopyMem (&PointerValue, PointerField, AddPointer->PointerSize);
-  if (PointerValue >= Blob2->Size) {
-    DEBUG ((
-      DEBUG_ERROR,
-      "%a: invalid pointer value in \"%a\"\n",
-      __func__,
-      AddPointer->PointerFile
-      ));
-    return EFI_PROTOCOL_ERROR;
-  }
+  Decoded->PointerOffset = AddPointer->PointerOffset;
+  Decoded->PointerSize   = AddPointer->PointerSize;
 
-  //
-  // The memory allocation system ensures that the address of the byte past the
-  // last byte of any allocated object is expressible (no wraparound).
-  //
-  ASSERT ((UINTN)Blob2->Base <= MAX_ADDRESS - Blob2->Size);
+  Blob->Referenced                                = TRUE;
+  Tracker->Blobs[Decoded->PointeeBlob].Referenced = TRUE;
 
-  PointerValue += (UINT64)(UINTN)Blob2->Base;
   if ((AddPointer->PointerSize < 8) &&
-      (RShiftU64 (PointerValue, AddPointer->PointerSize * 8) != 0))
+      !Tracker->Blobs[Decoded->PointeeBlob].Restricted32Bit)
   {
     DEBUG ((
-      DEBUG_ERROR,
-      "%a: relocated pointer value unrepresentable in "
-      "\"%a\"\n",
+      DEBUG_VERBOSE,
+      "%a: restricting blob \"%a\" from 64-bit allocation\n",
       __func__,
-      AddPointer->PointerFile
+      AddPointer->PointeeFile
       ));
-    return EFI_PROTOCOL_ERROR;
+    Tracker->Blobs[Decoded->PointeeBlob].Restricted32Bit = TRUE;
   }
 
-  CopyMem (PointerField, &PointerValue, AddPointer->PointerSize);
-
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a: PointerFile=\"%a\" PointeeFile=\"%a\" "
-    "PointerOffset=0x%x PointerSize=%d\n",
-    __func__,
-    AddPointer->PointerFile,
-    AddPointer->PointeeFile,
-    AddPointer->PointerOffset,
-    AddPointer->PointerSize
-    ));
   return EFI_SUCCESS;
 }
 
 /**
-  Process a QEMU_LOADER_ADD_CHECKSUM command.
+  Decode a QEMU_LOADER_ADD_CHECKSUM command.
+
+  @param[in] AddChecksum  The QEMU_LOADER_ADD_CHECKSUM command to decode.
 
-  @param[in] AddChecksum  The QEMU_LOADER_ADD_CHECKSUM command to process.
+  @param[in] Tracker      The BLOB_INDEX tracking the blobs decoded thus far.
 
-  @param[in] Tracker      The ORDERED_COLLECTION tracking the BLOB user
-                          structures created thus far.
+  @param[out] Decoded     The decoded command.
+
+  @retval EFI_SUCCESS         AddChecksum has been decoded.
 
   @retval EFI_PROTOCOL_ERROR  Malformed fw_cfg file name has been found in
                               AddChecksum, or the AddChecksum command
                               references a file unknown to Tracker, or the
                               range to checksum is invalid.
-
-  @retval EFI_SUCCESS         The requested range has been checksummed.
 **/
 STATIC
 EFI_STATUS
-/**
- * @brief Computes and stores an 8-bit checksum over a specified range in a tracked blob.
- *
- * Validates the checksum command, locates the referenced blob, computes the checksum over the given range, and writes the result at the specified offset within the blob.
- *
- * @retval EFI_SUCCESS            The checksum was computed and stored successfully.
- * @retval EFI_PROTOCOL_ERROR     The command is malformed, references an invalid blob, or specifies an invalid range.
- */
-EFIAPI
-ProcessCmdAddChecksum (
-  IN CONST QEMU_LOADER_ADD_CHECKSUM  *AddChecksum,
-  IN CONST ORDERED_COLLECTION        *Tracker
+DecodeCmdAddChecksum (
+  IN  CONST QEMU_LOADER_ADD_CHECKSUM  *AddChecksum,
+  IN  CONST BLOB_INDEX                *Tracker,
+  OUT LOADER_ADD_CHECKSUM             *Decoded
   )
 {
-  ORDERED_COLLECTION_ENTRY  *TrackerEntry;
-  BLOB                      *Blob;
+  CONST BLOB  *Blob;
 
   if (AddChecksum->File[QEMU_LOADER_FNAME_SIZE - 1] != '\0') {
     DEBUG ((DEBUG_ERROR, "%a: malformed file name\n", __func__));
     return EFI_PROTOCOL_ERROR;
   }
 
-  TrackerEntry = OrderedCollectionFind (Tracker, AddChecksum->File);
-  if (TrackerEntry == NULL) {
+  if (EFI_ERROR (BlobIndexFind (Tracker, AddChecksum->File, &Decoded->Blob))) {
     DEBUG ((
       DEBUG_ERROR,
       "%a: invalid blob reference \"%a\"\n",
@@ -641,7 +860,7 @@ ProcessCmdAddChecksum (
     return EFI_PROTOCOL_ERROR;
   }
 
-  Blob = OrderedCollectionUserStruct (TrackerEntry);
+  Blob = &Tracker->Blobs[Decoded->Blob];
   if ((Blob->Size <= AddChecksum->ResultOffset) ||
       (Blob->Size < AddChecksum->Length) ||
       (Blob->Size - AddChecksum->Length < AddChecksum->Start))
@@ -655,50 +874,41 @@ ProcessCmdAddChecksum (
     return EFI_PROTOCOL_ERROR;
   }
 
-  Blob->Base[AddChecksum->ResultOffset] = CalculateCheckSum8 (
-                                            Blob->Base + AddChecksum->Start,
-                                            AddChecksum->Length
-                                            );
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a: File=\"%a\" ResultOffset=0x%x Start=0x%x "
-    "Length=0x%x\n",
-    __func__,
-    AddChecksum->File,
-    AddChecksum->ResultOffset,
-    AddChecksum->Start,
-    AddChecksum->Length
-    ));
+  Decoded->ResultOffset = AddChecksum->ResultOffset;
+  Decoded->Start        = AddChecksum->Start;
+  Decoded->Length       = AddChecksum->Length;
   return EFI_SUCCESS;
 }
 
 /**
- * @brief Processes a QEMU_LOADER_WRITE_POINTER command to update a pointer in a writable fw_cfg file.
- *
- * Validates the command, locates the target fw_cfg file and referenced blob, computes the absolute pointer value, and writes it into the specified offset in the fw_cfg file. If S3 resume is enabled, the pointer write is also recorded for replay after S3 resume. Marks the referenced blob as unreleasable after the pointer is written.
- *
- * @param[in] WritePointer   The QEMU_LOADER_WRITE_POINTER command to process.
- * @param[in] Tracker        The collection tracking BLOB structures created so far.
- * @param[in,out] S3Context  The S3_CONTEXT for capturing pointer writes for S3 resume, or NULL if S3 is disabled.
- *
- * @retval EFI_SUCCESS           The pointer was written successfully, and recorded for S3 resume if applicable.
- * @retval EFI_PROTOCOL_ERROR    The command is malformed, references unknown files or blobs, or specifies invalid pointer parameters.
- * @return                       Error codes from SaveCondensedWritePointerToS3Context() if S3 context recording fails.
- */
+  Decode a QEMU_LOADER_WRITE_POINTER command.
+
+  @param[in] WritePointer  The QEMU_LOADER_WRITE_POINTER command to decode.
+
+  @param[in] Tracker       The BLOB_INDEX tracking the blobs decoded thus far.
+
+  @param[out] Decoded      The decoded command.
+
+  @retval EFI_SUCCESS         WritePointer has been decoded.
+
+  @retval EFI_PROTOCOL_ERROR  Malformed fw_cfg file name(s) have been found in
+                              WritePointer, or the WritePointer command
+                              references a file unknown to fw_cfg or to
+                              Tracker, or the pointer to write has invalid
+                              location or size, or the PointeeOffset field is
+                              out of range.
+**/
 STATIC
 EFI_STATUS
-ProcessCmdWritePointer (
-  IN     CONST QEMU_LOADER_WRITE_POINTER  *WritePointer,
-  IN     CONST ORDERED_COLLECTION         *Tracker,
-  IN OUT       S3_CONTEXT                 *S3Context OPTIONAL
+DecodeCmdWritePointer (
+  IN  CONST QEMU_LOADER_WRITE_POINTER  *WritePointer,
+  IN  CONST BLOB_INDEX                 *Tracker,
+  OUT LOADER_WRITE_POINTER             *Decoded
   )
 {
-  RETURN_STATUS             Status;
-  FIRMWARE_CONFIG_ITEM      PointerItem;
-  UINTN                     PointerItemSize;
-  ORDERED_COLLECTION_ENTRY  *PointeeEntry;
-  BLOB                      *PointeeBlob;
-  UINT64                    PointerValue;
+  RETURN_STATUS         Status;
+  FIRMWARE_CONFIG_ITEM  PointerItem;
+  UINTN                 PointerItemSize;
 
   if ((WritePointer->PointerFile[QEMU_LOADER_FNAME_SIZE - 1] != '\0') ||
       (WritePointer->PointeeFile[QEMU_LOADER_FNAME_SIZE - 1] != '\0'))
@@ -712,8 +922,15 @@ ProcessCmdWritePointer (
              &PointerItem,
              &PointerItemSize
              );
-  PointeeEntry = OrderedCollectionFind (Tracker, WritePointer->PointeeFile);
-  if (RETURN_ERROR (Status) || (PointeeEntry == NULL)) {
+  if (RETURN_ERROR (Status) ||
+      EFI_ERROR (
+        BlobIndexFind (
+          Tracker,
+          WritePointer->PointeeFile,
+          &Decoded->PointeeBlob
+          )
+        ))
+  {
     DEBUG ((
       DEBUG_ERROR,
       "%a: invalid fw_cfg file or blob reference \"%a\" / \"%a\"\n",
@@ -739,260 +956,1643 @@ ProcessCmdWritePointer (
     return EFI_PROTOCOL_ERROR;
   }
 
-  PointeeBlob  = OrderedCollectionUserStruct (PointeeEntry);
-  PointerValue = WritePointer->PointeeOffset;
-  if (PointerValue >= PointeeBlob->Size) {
+  if (WritePointer->PointeeOffset >=
+      Tracker->Blobs[Decoded->PointeeBlob].Size)
+  {
     DEBUG ((DEBUG_ERROR, "%a: invalid PointeeOffset\n", __func__));
     return EFI_PROTOCOL_ERROR;
   }
 
-  //
-  // The memory allocation system ensures that the address of the byte past the
-  // last byte of any allocated object is expressible (no wraparound).
-  //
-  ASSERT ((UINTN)PointeeBlob->Base <= MAX_ADDRESS - PointeeBlob->Size);
+  Tracker->Blobs[Decoded->PointeeBlob].Referenced = TRUE;
 
-  PointerValue += (UINT64)(UINTN)PointeeBlob->Base;
-  if ((WritePointer->PointerSize < 8) &&
-      (RShiftU64 (PointerValue, WritePointer->PointerSize * 8) != 0))
-  {
-    DEBUG ((
-      DEBUG_ERROR,
-      "%a: pointer value unrepresentable in \"%a\"\n",
-      __func__,
-      WritePointer->PointerFile
-      ));
-    return EFI_PROTOCOL_ERROR;
-  }
+  Decoded->PointerItem   = (UINT16)PointerItem;
+  Decoded->PointerSize   = WritePointer->PointerSize;
+  Decoded->PointerOffset = WritePointer->PointerOffset;
+  Decoded->PointeeOffset = WritePointer->PointeeOffset;
+  return EFI_SUCCESS;
+}
 
-  //
-  // If S3 is enabled, we have to capture the below fw_cfg actions in condensed
-  // form, to be replayed during S3 resume.
-  //
-  if (S3Context != NULL) {
-    EFI_STATUS  SaveStatus;
+/**
+  Release the arrays of a LOADER_SCRIPT. The blob contents (if any) are not
+  freed.
 
-    SaveStatus = SaveCondensedWritePointerToS3Context (
-                   S3Context,
-                   (UINT16)PointerItem,
-                   WritePointer->PointerSize,
-                   WritePointer->PointerOffset,
-                   PointerValue
-                   );
-    if (EFI_ERROR (SaveStatus)) {
-      return SaveStatus;
-    }
-  }
+  @param[in] Script  The LOADER_SCRIPT populated by DecodeLoaderScript().
+**/
+STATIC
+VOID
+ReleaseLoaderScript (
+  IN LOADER_SCRIPT  *Script
+  )
+{
+  FreePool (Script->SummedRanges);
+  FreePool (Script->AddPointers);
+  FreePool (Script->Blobs);
+  FreePool (Script->Commands);
+}
 
-  QemuFwCfgSelectItem (PointerItem);
-  QemuFwCfgSkipBytes (WritePointer->PointerOffset);
-  QemuFwCfgWriteBytes (WritePointer->PointerSize, &PointerValue);
+/**
+  Order two LOADER_ADD_CHECKSUM commands by blob, start and length; used for
+  sorting and searching LOADER_SCRIPT.SummedRanges.
 
-  //
-  // Because QEMU has now learned PointeeBlob->Base, we must mark PointeeBlob
-  // as unreleasable, for the case when the whole linker/loader script is
-  // handled successfully.
-  //
-  PointeeBlob->HostsOnlyTableData = FALSE;
+  @param[in] Buffer1  The first LOADER_ADD_CHECKSUM to compare.
 
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a: PointerFile=\"%a\" PointeeFile=\"%a\" "
-    "PointerOffset=0x%x PointeeOffset=0x%x PointerSize=%d\n",
-    __func__,
-    WritePointer->PointerFile,
-    WritePointer->PointeeFile,
-    WritePointer->PointerOffset,
-    WritePointer->PointeeOffset,
-    WritePointer->PointerSize
-    ));
-  return EFI_SUCCESS;
-}
+  @param[in] Buffer2  The second LOADER_ADD_CHECKSUM to compare.
 
-/**
- * @brief Reverts a QEMU_LOADER_WRITE_POINTER command by zeroing the pointer field in the specified fw_cfg file.
- *
- * This function clears a previously written guest memory pointer in a fw_cfg file, effectively undoing the effect of a QEMU_LOADER_WRITE_POINTER command that was successfully processed earlier.
- *
- * @param[in] WritePointer Pointer to the QEMU_LOADER_WRITE_POINTER command structure describing the pointer to be zeroed.
- */
+  @retval <0  Buffer1 sorts before Buffer2.
+
+  @retval 0   Buffer1 and Buffer2 cover the same range of the same blob.
+
+  @retval >0  Buffer1 sorts after Buffer2.
+**/
 STATIC
-VOID
-UndoCmdWritePointer (
-  IN CONST QEMU_LOADER_WRITE_POINTER  *WritePointer
+INTN
+CompareSummedRange (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
   )
 {
-  RETURN_STATUS         Status;
-  FIRMWARE_CONFIG_ITEM  PointerItem;
-  UINTN                 PointerItemSize;
-  UINT64                PointerValue;
+  CONST LOADER_ADD_CHECKSUM  *Range1;
+  CONST LOADER_ADD_CHECKSUM  *Range2;
 
-  Status = QemuFwCfgFindFile (
-             (CONST CHAR8 *)WritePointer->PointerFile,
-             &PointerItem,
-             &PointerItemSize
-             );
-  ASSERT_RETURN_ERROR (Status);
+  Range1 = Buffer1;
+  Range2 = Buffer2;
+  if (Range1->Blob != Range2->Blob) {
+    return (Range1->Blob < Range2->Blob) ? -1 : 1;
+  }
 
-  PointerValue = 0;
-  QemuFwCfgSelectItem (PointerItem);
-  QemuFwCfgSkipBytes (WritePointer->PointerOffset);
-  QemuFwCfgWriteBytes (WritePointer->PointerSize, &PointerValue);
+  if (Range1->Start != Range2->Start) {
+    return (Range1->Start < Range2->Start) ? -1 : 1;
+  }
 
-  DEBUG ((
-    DEBUG_VERBOSE,
-    "%a: PointerFile=\"%a\" PointerOffset=0x%x PointerSize=%d\n",
-    __func__,
-    WritePointer->PointerFile,
-    WritePointer->PointerOffset,
-    WritePointer->PointerSize
-    ));
-}
+  if (Range1->Length != Range2->Length) {
+    return (Range1->Length < Range2->Length) ? -1 : 1;
+  }
 
-//
-// We'll be saving the keys of installed tables so that we can roll them back
-// in case of failure. 128 tables should be enough for anyone (TM).
-//
-#define INSTALLED_TABLES_MAX  128
+  return 0;
+}
 
 /**
-  Process a QEMU_LOADER_ADD_POINTER command in order to see if its target byte
-  array is an ACPI table, and if so, install it.
+  Try to coalesce a pointer write with the CONDENSED_WRITE recorded before it.
 
-  This function assumes that the entire QEMU linker/loader command file has
-  been processed successfully in a prior first pass.
+  @param[in,out] Write     The CONDENSED_WRITE recorded last. On success, it
+                           covers the new pointer write as well.
 
-  @param[in] AddPointer        The QEMU_LOADER_ADD_POINTER command to process.
+  @param[in] PointerItem   The fw_cfg item of the new pointer write.
 
-  @param[in] Tracker           The ORDERED_COLLECTION tracking the BLOB user
-                               structures.
+  @param[in] PointerSize   The size of the new pointer write.
 
-  @param[in] AcpiProtocol      The ACPI table protocol used to install tables.
+  @param[in] PointerOffset The offset of the new pointer write in the fw_cfg
+                           item.
 
-  @param[in,out] InstalledKey  On input, an array of INSTALLED_TABLES_MAX UINTN
-                               elements, allocated by the caller. On output,
-                               the function will have stored (appended) the
-                               AcpiProtocol-internal key of the ACPI table that
-                               the function has installed, if the AddPointer
-                               command identified an ACPI table that is
-                               different from RSDT and XSDT.
-
-  @param[in,out] NumInstalled  On input, the number of entries already used in
-                               InstalledKey; it must be in [0,
-                               INSTALLED_TABLES_MAX] inclusive. On output, the
-                               parameter is incremented if the AddPointer
-                               command identified an ACPI table that is
-                               different from RSDT and XSDT.
-
-  @param[in,out] SeenPointers  The ORDERED_COLLECTION tracking the absolute
-                               target addresses that have been pointed-to by
-                               QEMU_LOADER_ADD_POINTER commands thus far. If a
-                               target address is encountered for the first
-                               time, and it identifies an ACPI table that is
-                               different from RDST and XSDT, the table is
-                               installed. If a target address is seen for the
-                               second or later times, it is skipped without
-                               taking any action.
+  @param[in] PointerValue  The value to write; representable in PointerSize
+                           bytes.
 
-  @retval EFI_INVALID_PARAMETER  NumInstalled was outside the allowed range on
-                                 input.
+  @retval TRUE   The new pointer write has been merged into Write.
 
-  @retval EFI_OUT_OF_RESOURCES   The AddPointer command identified an ACPI
-                                 table different from RSDT and XSDT, but there
-                                 was no more room in InstalledKey.
+  @retval FALSE  The new pointer write has to be recorded separately.
+**/
+STATIC
+BOOLEAN
+CondensedWriteAppend (
+  IN OUT CONDENSED_WRITE  *Write,
+  IN     UINT16           PointerItem,
+  IN     UINT8            PointerSize,
+  IN     UINT32           PointerOffset,
+  IN     UINT64           PointerValue
+  )
+{
+  if ((Write->PointerSize == 0) ||
+      (Write->PointerItem != PointerItem) ||
+      (Write->PointerOffset + Write->PointerSize != PointerOffset) ||
+      (Write->PointerSize + PointerSize > sizeof Write->PointerValue))
+  {
+    return FALSE;
+  }
 
-  @retval EFI_SUCCESS            AddPointer has been processed. Either its
-                                 absolute target address has been encountered
-                                 before, or an ACPI table different from RSDT
-                                 and XSDT has been installed (reflected by
-                                 InstalledKey and NumInstalled), or RSDT or
-                                 XSDT has been identified but not installed, or
-                                 the fw_cfg blob pointed-into by AddPointer has
-                                 been marked as hosting something else than
-                                 just direct ACPI table contents.
+  Write->PointerValue |= LShiftU64 (PointerValue, Write->PointerSize * 8);
+  Write->PointerSize  += PointerSize;
+  return TRUE;
+}
 
-  @return                        Error codes returned by
-                                 AcpiProtocol->InstallAcpiTable().
+/**
+  Validate the linker/loader script, and decode it into a LOADER_SCRIPT.
+
+  This is the only function that reads the QEMU_LOADER_ENTRY array (once to
+  size the output, once to decode it); all later processing consumes the
+  LOADER_SCRIPT, in which file names have been resolved to blob indices, the
+  32-bit restrictions of the blobs have been determined, and the AddPointer
+  commands (i.e., the candidate ACPI table locations) have been listed. Every
+  check that does not depend on blob contents or blob addresses is done here,
+  so a malformed script is rejected before any memory is allocated for the
+  blobs, and before anything is written to fw_cfg.
+
+  The LOADER_SCRIPT does not reference the QEMU_LOADER_ENTRY array.
+
+  @param[in] LoaderStart  Points to the first entry in the linker/loader
+                          script.
+
+  @param[in] LoaderEnd    Points one past the last entry in the linker/loader
+                          script.
+
+  @param[out] Script      On success, the decoded script. The caller is
+                          responsible for releasing it with
+                          ReleaseLoaderScript().
+
+  @retval EFI_SUCCESS           The script has been decoded.
+
+  @retval EFI_OUT_OF_RESOURCES  Pool allocation failed.
+
+  @return                       Error codes from DecodeCmdAllocate(),
+                                DecodeCmdAddPointer(), DecodeCmdAddChecksum()
+                                and DecodeCmdWritePointer().
 **/
 STATIC
 EFI_STATUS
-/**
- * @brief Processes a QEMU_LOADER_ADD_POINTER command in the second pass to identify and install ACPI tables.
- *
- * Examines the pointer target specified by the loader command to determine if it references a valid ACPI table or FACS structure. If a valid table is found (excluding RSDT and XSDT), installs it using the EFI_ACPI_TABLE_PROTOCOL and tracks the installation to prevent duplicates. Marks blobs as opaque if no ACPI table is found. Handles resource limits and avoids reprocessing already seen pointers.
- *
- * @param AddPointer The loader command describing the pointer relocation.
- * @param Tracker Collection of all tracked blobs.
- * @param AcpiProtocol ACPI table protocol for table installation.
- * @param InstalledKey Array for storing installed table keys.
- * @param NumInstalled Pointer to the count of installed tables; incremented on success.
- * @param SeenPointers Collection tracking already processed pointer values.
- * @return EFI_SUCCESS on success, or an appropriate EFI error code on failure.
- */
-EFIAPI
-Process2ndPassCmdAddPointer (
-  IN     CONST QEMU_LOADER_ADD_POINTER  *AddPointer,
-  IN     CONST ORDERED_COLLECTION       *Tracker,
-  IN     EFI_ACPI_TABLE_PROTOCOL        *AcpiProtocol,
-  IN OUT UINTN                          InstalledKey[INSTALLED_TABLES_MAX],
-  IN OUT INT32                          *NumInstalled,
-  IN OUT ORDERED_COLLECTION             *SeenPointers
+DecodeLoaderScript (
+  IN  CONST QEMU_LOADER_ENTRY  *LoaderStart,
+  IN  CONST QEMU_LOADER_ENTRY  *LoaderEnd,
+  OUT LOADER_SCRIPT            *Script
   )
 {
-  CONST ORDERED_COLLECTION_ENTRY                      *TrackerEntry;
-  CONST ORDERED_COLLECTION_ENTRY                      *TrackerEntry2;
-  ORDERED_COLLECTION_ENTRY                            *SeenPointerEntry;
-  CONST BLOB                                          *Blob;
-  BLOB                                                *Blob2;
-  CONST UINT8                                         *PointerField;
-  UINT64                                              PointerValue;
-  UINTN                                               Blob2Remaining;
-  UINTN                                               TableSize;
-  CONST EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE  *Facs;
-  CONST EFI_ACPI_DESCRIPTION_HEADER                   *Header;
-  EFI_STATUS                                          Status;
+  CONST QEMU_LOADER_ENTRY  *LoaderEntry;
+  UINTN                    AllocateCount;
+  UINTN                    AddPointerCount;
+  UINTN                    AddChecksumCount;
+  UINTN                    CommandCount;
+  BLOB_INDEX               Tracker;
+  LOADER_COMMAND           *Command;
+  LOADER_ADD_CHECKSUM      *AddChecksum;
+  LOADER_ADD_CHECKSUM      SortScratch;
+  LOADER_WRITE_POINTER     *WritePointer;
+  CONDENSED_WRITE          CondensedWrite;
+  UINTN                    Index;
+  UINTN                    Insert;
+  LOADER_STAT              *Stat;
+  UINT64                   StartTicks;
+  EFI_STATUS               Status;
 
-  if ((*NumInstalled < 0) || (*NumInstalled > INSTALLED_TABLES_MAX)) {
-    return EFI_INVALID_PARAMETER;
+  AllocateCount    = 0;
+  AddPointerCount  = 0;
+  AddChecksumCount = 0;
+  CommandCount     = 0;
+  for (LoaderEntry = LoaderStart; LoaderEntry < LoaderEnd; ++LoaderEntry) {
+    ++mLoaderEntryReads;
+    switch (LoaderEntry->Type) {
+      case QemuLoaderCmdAllocate:
+        ++AllocateCount;
+        break;
+      case QemuLoaderCmdAddPointer:
+        ++AddPointerCount;
+        ++CommandCount;
+        break;
+      case QemuLoaderCmdAddChecksum:
+        ++AddChecksumCount;
+        ++CommandCount;
+        break;
+      case QemuLoaderCmdWritePointer:
+        ++CommandCount;
+        break;
+      default:
+        break;
+    }
   }
 
-  TrackerEntry  = OrderedCollectionFind (Tracker, AddPointer->PointerFile);
-  TrackerEntry2 = OrderedCollectionFind (Tracker, AddPointer->PointeeFile);
-  Blob          = OrderedCollectionUserStruct (TrackerEntry);
-  Blob2         = OrderedCollectionUserStruct (TrackerEntry2);
-  PointerField  = Blob->Base + AddPointer->PointerOffset;
-  PointerValue  = 0;
-  CopyMem (&PointerValue, PointerField, AddPointer->PointerSize);
-
   //
-  // We assert that PointerValue falls inside Blob2's contents. This is ensured
-  // by the Blob2->Size check and later checks in ProcessCmdAddPointer().
+  // Allocate at least one element of each array so that FreePool() is always
+  // valid on the result.
+  //
+  ZeroMem (Script, sizeof *Script);
+  Script->Commands = AllocatePool (
+                       MAX (CommandCount, 1) * sizeof *Script->Commands
+                       );
+  Script->Blobs = AllocateZeroPool (
+                    MAX (AllocateCount, 1) * sizeof *Script->Blobs
+                    );
+  Script->AddPointers = AllocatePool (
+                          MAX (AddPointerCount, 1) * sizeof *Script->AddPointers
+                          );
+  Script->SummedRanges = AllocatePool (
+                           MAX (AddChecksumCount, 1) *
+                           sizeof *Script->SummedRanges
+                           );
+  if ((Script->Commands == NULL) || (Script->Blobs == NULL) ||
+      (Script->AddPointers == NULL) || (Script->SummedRanges == NULL))
+  {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto FreeScript;
+  }
+
+  Status = BlobIndexInit (&Tracker, Script->Blobs, AllocateCount);
+  if (EFI_ERROR (Status)) {
+    goto FreeScript;
+  }
+
+  mLoaderStats[LoaderStatAllocate].PoolAllocations += 4;
+
+  ZeroMem (&CondensedWrite, sizeof CondensedWrite);
+  for (LoaderEntry = LoaderStart; LoaderEntry < LoaderEnd; ++LoaderEntry) {
+    ++mLoaderEntryReads;
+    StartTicks = GetPerformanceCounter ();
+
+    Command       = &Script->Commands[Script->CommandCount];
+    Command->Type = LoaderEntry->Type;
+
+    switch (LoaderEntry->Type) {
+      case QemuLoaderCmdAllocate:
+        Status = DecodeCmdAllocate (
+                   &LoaderEntry->Command.Allocate,
+                   &Tracker,
+                   Script->BlobCount
+                   );
+        if (!EFI_ERROR (Status)) {
+          ++Script->BlobCount;
+        }
+
+        break;
+
+      case QemuLoaderCmdAddPointer:
+        Status = DecodeCmdAddPointer (
+                   &LoaderEntry->Command.AddPointer,
+                   &Tracker,
+                   &Command->Command.AddPointer
+                   );
+        if (!EFI_ERROR (Status)) {
+          Script->AddPointers[Script->AddPointerCount++] =
+            (UINT32)Script->CommandCount++;
+        }
+
+        break;
+
+      case QemuLoaderCmdAddChecksum:
+        Status = DecodeCmdAddChecksum (
+                   &LoaderEntry->Command.AddChecksum,
+                   &Tracker,
+                   &Command->Command.AddChecksum
+                   );
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+
+        AddChecksum = &Command->Command.AddChecksum;
+        if ((AddChecksum->ResultOffset >= AddChecksum->Start) &&
+            (AddChecksum->ResultOffset - AddChecksum->Start <
+             AddChecksum->Length))
+        {
+          Script->SummedRanges[Script->SummedRangeCount++] = *AddChecksum;
+        }
+
+        ++Script->CommandCount;
+        break;
+
+      case QemuLoaderCmdWritePointer:
+        Status = DecodeCmdWritePointer (
+                   &LoaderEntry->Command.WritePointer,
+                   &Tracker,
+                   &Command->Command.WritePointer
+                   );
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+
+        //
+        // Count the CONDENSED_WRITEs for sizing the S3 context. The values
+        // are not known yet, but they do not affect coalescing.
+        //
+        WritePointer = &Command->Command.WritePointer;
+        if (!CondensedWriteAppend (
+               &CondensedWrite,
+               WritePointer->PointerItem,
+               WritePointer->PointerSize,
+               WritePointer->PointerOffset,
+               0
+               ))
+        {
+          CondensedWrite.PointerItem   = WritePointer->PointerItem;
+          CondensedWrite.PointerSize   = WritePointer->PointerSize;
+          CondensedWrite.PointerOffset = WritePointer->PointerOffset;
+          ++Script->CondensedWriteCount;
+        }
+
+        ++Script->CommandCount;
+        ++Script->WritePointerCount;
+        break;
+
+      default:
+        DEBUG ((
+          DEBUG_VERBOSE,
+          "%a: unknown loader command: 0x%x\n",
+          __func__,
+          LoaderEntry->Type
+          ));
+        break;
+    }
+
+    Stat = LoaderStatForCommand (LoaderEntry->Type);
+    if (Stat != NULL) {
+      Stat->Count++;
+      Stat->Ticks += GetPerformanceCounter () - StartTicks;
+    }
+
+    if (EFI_ERROR (Status)) {
+      goto UninitTracker;
+    }
+  }
+
+  ASSERT (Script->BlobCount == AllocateCount);
+  ASSERT (Script->CommandCount == CommandCount);
+
+  //
+  // QEMU emits the checksums of the tables in a blob in ascending order, so an
+  // insertion sort normally makes a single pass over an already sorted array.
+  //
+  AddChecksum = Script->SummedRanges;
+  for (Index = 1; Index < Script->SummedRangeCount; ++Index) {
+    SortScratch = AddChecksum[Index];
+    Insert      = Index;
+    while ((Insert > 0) &&
+           (CompareSummedRange (&AddChecksum[Insert - 1], &SortScratch) > 0))
+    {
+      AddChecksum[Insert] = AddChecksum[Insert - 1];
+      --Insert;
+    }
+
+    AddChecksum[Insert] = SortScratch;
+  }
+
+UninitTracker:
+  BlobIndexUninit (&Tracker);
+  if (!EFI_ERROR (Status)) {
+    return EFI_SUCCESS;
+  }
+
+FreeScript:
+  if (Script->SummedRanges != NULL) {
+    FreePool (Script->SummedRanges);
+  }
+
+  if (Script->AddPointers != NULL) {
+    FreePool (Script->AddPointers);
+  }
+
+  if (Script->Blobs != NULL) {
+    FreePool (Script->Blobs);
+  }
+
+  if (Script->Commands != NULL) {
+    FreePool (Script->Commands);
+  }
+
+  return Status;
+}
+
+/**
+  Fold bytes into a 64-bit FNV-1a hash.
+
+  @param[in] Hash    The hash value so far.
+
+  @param[in] Data    The bytes to fold in.
+
+  @param[in] Size    The number of bytes in Data.
+
+  @return  The updated hash value.
+**/
+STATIC
+UINT64
+Fnv1a64 (
+  IN UINT64      Hash,
+  IN CONST VOID  *Data,
+  IN UINTN       Size
+  )
+{
+  CONST UINT8  *Byte;
+
+  for (Byte = Data; Size > 0; --Size) {
+    Hash ^= *Byte++;
+    Hash  = MultU64x64 (Hash, 0x00000100000001B3ULL);
+  }
+
+  return Hash;
+}
+
+/**
+  Hash the layout of the ACPI configuration that QEMU presents: the
+  linker/loader script, and the names and sizes of the blobs it allocates.
+
+  The hash only goes to the verbose debug log, where it helps to tell whether
+  two boot logs come from the same loader script. It says nothing about the
+  blob contents, which can change while their sizes stay the same.
+
+  @param[in] LoaderStart  Points to the first entry in the linker/loader
+                          script.
+
+  @param[in] LoaderEnd    Points one past the last entry in the linker/loader
+                          script.
+
+  @param[in] Script       The LOADER_SCRIPT decoded from the entries.
+
+  @return  The hash value.
+**/
+STATIC
+UINT64
+LoaderLayoutHash (
+  IN CONST QEMU_LOADER_ENTRY  *LoaderStart,
+  IN CONST QEMU_LOADER_ENTRY  *LoaderEnd,
+  IN CONST LOADER_SCRIPT      *Script
+  )
+{
+  UINT64      Hash;
+  UINTN       Index;
+  CONST BLOB  *Blob;
+  UINT64      Size;
+
+  Hash = Fnv1a64 (
+           0xCBF29CE484222325ULL,
+           LoaderStart,
+           (UINTN)LoaderEnd - (UINTN)LoaderStart
+           );
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    Blob = &Script->Blobs[Index];
+    Size = Blob->Size;
+    Hash = Fnv1a64 (Hash, Blob->File, AsciiStrLen ((CONST CHAR8 *)Blob->File));
+    Hash = Fnv1a64 (Hash, &Size, sizeof Size);
+  }
+
+  return Hash;
+}
+
+/**
+  Download an fw_cfg item, and measure it into PCR[1] as ACPI data.
+
+  Everything that QEMU hands to the firmware for ACPI (the linker/loader
+  script, the blobs, and the VBIOS image) has to be measured before it is
+  consumed, because processing modifies it. Measuring each item right after
+  reading it, rather than in a separate pass once everything has been read,
+  hashes the data while it is still cache-hot. The event log is the same: one
+  event per item, in download order.
+
+  @param[in] Item     The fw_cfg item to download.
+
+  @param[in] Size     The number of bytes to download.
+
+  @param[out] Buffer  The buffer to download the item into.
+**/
+STATIC
+VOID
+DownloadAndMeasure (
+  IN  FIRMWARE_CONFIG_ITEM  Item,
+  IN  UINTN                 Size,
+  OUT VOID                  *Buffer
+  )
+{
+  QemuFwCfgSelectItem (Item);
+  QemuFwCfgReadBytes (Size, Buffer);
+  mLoaderFwCfgBytes += Size;
+  TpmMeasureAndLogData (
+    1,
+    EV_PLATFORM_CONFIG_FLAGS,
+    EV_POSTCODE_INFO_ACPI_DATA,
+    ACPI_DATA_LEN,
+    Buffer,
+    Size
+    );
+}
+
+/**
+  Map a blob to the NVS arena that it is sub-allocated from.
+
+  @param[in] Blob  The blob to look up.
+
+  @return  The NVS_ARENA_TYPE of Blob.
+**/
+STATIC
+NVS_ARENA_TYPE
+BlobArena (
+  IN CONST BLOB  *Blob
+  )
+{
+  return Blob->Restricted32Bit ? NvsArenaBelow4G : NvsArenaAnywhere;
+}
+
+/**
+  Allocate AcpiNVS memory for, and download, every fw_cfg blob of the decoded
+  linker/loader script.
+
+  Knowing all the Allocate targets up front lets us issue the fw_cfg transfers
+  back to back, in a single pass, rather than interleaving them with the
+  processing of the other commands. (QemuFwCfgReadBytes() uses the fw_cfg DMA
+  interface whenever QEMU offers it.) Each blob is measured right after it has
+  been downloaded.
+
+  Blobs that no AddPointer or WritePointer command refers to get no AcpiNVS
+  memory: no table can be installed from them, and neither the OS nor QEMU
+  can learn their addresses, so nothing would ever consume their contents.
+  Their Base stays NULL. They are still read, into a scratch pool buffer, and
+  measured in their place in the script, so that the event log covers all of
+  the ACPI data that QEMU offers.
+
+  Rather than rounding each blob up to whole pages, the blobs are packed, at
+  their requested alignments and in script order, into at most two AcpiNVS
+  page ranges (see NVS_ARENA_TYPE). Any padding between and after the blobs is
+  zeroed.
+
+  @param[in,out] Script  The LOADER_SCRIPT populated by DecodeLoaderScript().
+                         On success, Script->Arena describes the AcpiNVS
+                         ranges, and the Base field of each BLOB points to the
+                         downloaded blob contents inside one of them. On
+                         failure, no blob memory remains allocated.
+
+  @retval EFI_SUCCESS           All referenced blobs have been allocated and
+                                downloaded, and all blobs have been measured.
+
+  @retval EFI_OUT_OF_RESOURCES  Out of memory for the scratch buffer.
+
+  @return                       Error codes from gBS->AllocatePages().
+**/
+STATIC
+EFI_STATUS
+DownloadBlobs (
+  IN OUT LOADER_SCRIPT  *Script
+  )
+{
+  BLOB            *Blob;
+  UINTN           Index;
+  NVS_ARENA_TYPE  ArenaType;
+  NVS_ARENA       *Arena;
+  UINTN           ArenaSize[NvsArenaMax];
+  UINT8           *ArenaCursor[NvsArenaMax];
+  UINT64          UnpackedPages;
+  EFI_STATUS      Status;
+  UINT64          StartTicks;
+  UINT64          DownloadTicks;
+  UINT64          TotalBytes;
+  UINT64          SkippedBytes;
+  UINTN           SkippedBlobs;
+  UINTN           ScratchSize;
+  UINT8           *Scratch;
+  UINT64          Nanoseconds;
+
+  StartTicks = GetPerformanceCounter ();
+
+  //
+  // Lay out the arenas, and allocate them.
+  //
+  ZeroMem (ArenaSize, sizeof ArenaSize);
+  UnpackedPages = 0;
+  SkippedBytes  = 0;
+  SkippedBlobs  = 0;
+  ScratchSize   = 0;
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    Blob = &Script->Blobs[Index];
+    if (!Blob->Referenced) {
+      DEBUG ((
+        DEBUG_VERBOSE,
+        "%a: not allocating unreferenced \"%a\"\n",
+        __func__,
+        Blob->File
+        ));
+      SkippedBytes += Blob->Size;
+      ++SkippedBlobs;
+      ScratchSize = MAX (ScratchSize, Blob->Size);
+      continue;
+    }
+
+    ArenaType  = BlobArena (Blob);
+    Blob->Base = (UINT8 *)ALIGN_VALUE (ArenaSize[ArenaType], Blob->Alignment);
+
+    ArenaSize[ArenaType] = (UINTN)Blob->Base + Blob->Size;
+    UnpackedPages       += EFI_SIZE_TO_PAGES (Blob->Size);
+  }
+
+  Scratch = NULL;
+  if (ScratchSize > 0) {
+    Scratch = AllocatePool (ScratchSize);
+    if (Scratch == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    mLoaderStats[LoaderStatAllocate].PoolAllocations++;
+  }
+
+  for (ArenaType = 0; ArenaType < NvsArenaMax; ++ArenaType) {
+    Arena        = &Script->Arena[ArenaType];
+    Arena->Base  = (ArenaType == NvsArenaBelow4G) ? MAX_UINT32 : MAX_UINT64;
+    Arena->Pages = EFI_SIZE_TO_PAGES (ArenaSize[ArenaType]);
+    if (Arena->Pages == 0) {
+      Arena->Base = 0;
+      continue;
+    }
+
+    Status = gBS->AllocatePages (
+                    AllocateMaxAddress,
+                    EfiACPIMemoryNVS,
+                    Arena->Pages,
+                    &Arena->Base
+                    );
+    if (EFI_ERROR (Status)) {
+      Arena->Pages = 0;
+      goto FreeArenas;
+    }
+
+    mLoaderStats[LoaderStatAllocate].PageAllocations++;
+    mLoaderStats[LoaderStatAllocate].Pages += Arena->Pages;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %Lu AcpiNVS pages instead of %Lu (%Lu bytes saved)\n",
+    __func__,
+    (UINT64)(Script->Arena[NvsArenaBelow4G].Pages +
+             Script->Arena[NvsArenaAnywhere].Pages),
+    UnpackedPages,
+    EFI_PAGES_TO_SIZE (
+      (UINTN)(UnpackedPages - Script->Arena[NvsArenaBelow4G].Pages -
+              Script->Arena[NvsArenaAnywhere].Pages)
+      )
+    ));
+
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    Blob = &Script->Blobs[Index];
+    if (!Blob->Referenced) {
+      continue;
+    }
+
+    Blob->Base += (UINTN)Script->Arena[BlobArena (Blob)].Base;
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a: File=\"%a\" Size=0x%Lx Address=0x%Lx\n",
+      __func__,
+      Blob->File,
+      (UINT64)Blob->Size,
+      (UINT64)(UINTN)Blob->Base
+      ));
+  }
+
+  //
+  // Download and measure all blobs in one go. The blobs have to be measured
+  // before they are consumed, because the following operations modify them.
+  //
+  for (ArenaType = 0; ArenaType < NvsArenaMax; ++ArenaType) {
+    ArenaCursor[ArenaType] = (UINT8 *)(UINTN)Script->Arena[ArenaType].Base;
+  }
+
+  DownloadTicks = GetPerformanceCounter ();
+  TotalBytes    = 0;
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    Blob = &Script->Blobs[Index];
+    if (!Blob->Referenced) {
+      DownloadAndMeasure (Blob->FwCfgItem, Blob->Size, Scratch);
+      continue;
+    }
+
+    ArenaType = BlobArena (Blob);
+    ZeroMem (ArenaCursor[ArenaType], Blob->Base - ArenaCursor[ArenaType]);
+    DownloadAndMeasure (Blob->FwCfgItem, Blob->Size, Blob->Base);
+    ArenaCursor[ArenaType] = Blob->Base + Blob->Size;
+    TotalBytes            += Blob->Size;
+  }
+
+  for (ArenaType = 0; ArenaType < NvsArenaMax; ++ArenaType) {
+    Arena = &Script->Arena[ArenaType];
+    if (Arena->Pages != 0) {
+      ZeroMem (
+        ArenaCursor[ArenaType],
+        (UINTN)Arena->Base + EFI_PAGES_TO_SIZE (Arena->Pages) -
+        (UINTN)ArenaCursor[ArenaType]
+        );
+    }
+  }
+
+  Nanoseconds = GetTimeInNanoSecond (GetPerformanceCounter () - DownloadTicks);
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: downloaded and measured %Lu bytes in %Lu blobs in %Luns "
+    "(%Lu bytes/s)\n",
+    __func__,
+    TotalBytes,
+    (UINT64)(Script->BlobCount - SkippedBlobs),
+    Nanoseconds,
+    (Nanoseconds == 0) ?
+    0 :
+    DivU64x64Remainder (MultU64x32 (TotalBytes, 1000000000), Nanoseconds, NULL)
+    ));
+  if (SkippedBlobs > 0) {
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: measured %Lu bytes in %Lu unreferenced blobs without allocating "
+      "them\n",
+      __func__,
+      SkippedBytes,
+      (UINT64)SkippedBlobs
+      ));
+  }
+
+  if (Scratch != NULL) {
+    FreePool (Scratch);
+  }
+
+  mLoaderStats[LoaderStatAllocate].Ticks += GetPerformanceCounter () -
+                                            StartTicks;
+  return EFI_SUCCESS;
+
+FreeArenas:
+  while (ArenaType > 0) {
+    --ArenaType;
+    Arena = &Script->Arena[ArenaType];
+    if (Arena->Pages != 0) {
+      gBS->FreePages (Arena->Base, Arena->Pages);
+      Arena->Pages = 0;
+    }
+  }
+
+  if (Scratch != NULL) {
+    FreePool (Scratch);
+  }
+
+  return Status;
+}
+
+/**
+  Release the AcpiNVS memory of the downloaded blobs.
+
+  @param[in,out] Script    The LOADER_SCRIPT whose blobs have been downloaded
+                           by DownloadBlobs().
+
+  @param[in] ReleaseAll    If TRUE, release all blob memory. Otherwise, only
+                           release the pages that are not covered by any blob
+                           that hosts data other than direct ACPI table
+                           contents (such blobs must stay in place, because
+                           QEMU or the OS may refer to them).
+**/
+STATIC
+VOID
+ReleaseBlobs (
+  IN OUT LOADER_SCRIPT  *Script,
+  IN     BOOLEAN        ReleaseAll
+  )
+{
+  NVS_ARENA_TYPE        ArenaType;
+  NVS_ARENA             *Arena;
+  EFI_PHYSICAL_ADDRESS  FreeStart;
+  EFI_PHYSICAL_ADDRESS  KeepStart;
+  EFI_PHYSICAL_ADDRESS  KeepEnd;
+  EFI_PHYSICAL_ADDRESS  ArenaEnd;
+  UINTN                 Index;
+  BLOB                  *Blob;
+  UINTN                 Kept;
+
+  Kept = 0;
+  for (ArenaType = 0; ArenaType < NvsArenaMax; ++ArenaType) {
+    Arena = &Script->Arena[ArenaType];
+    if (Arena->Pages == 0) {
+      continue;
+    }
+
+    //
+    // The blobs of each arena are laid out in increasing address order.
+    //
+    FreeStart = Arena->Base;
+    ArenaEnd  = Arena->Base + EFI_PAGES_TO_SIZE (Arena->Pages);
+    for (Index = 0; Index < Script->BlobCount && !ReleaseAll; ++Index) {
+      Blob = &Script->Blobs[Index];
+      if (BlobArena (Blob) != ArenaType) {
+        continue;
+      }
+
+      if (Blob->HostsOnlyTableData) {
+        DEBUG ((
+          DEBUG_VERBOSE,
+          "%a: freeing \"%a\"\n",
+          __func__,
+          Blob->File
+          ));
+        continue;
+      }
+
+      KeepStart = (UINTN)Blob->Base & ~(UINTN)EFI_PAGE_MASK;
+      KeepEnd   = ALIGN_VALUE ((UINTN)Blob->Base + Blob->Size, EFI_PAGE_SIZE);
+      if (KeepStart > FreeStart) {
+        gBS->FreePages (
+               FreeStart,
+               EFI_SIZE_TO_PAGES ((UINTN)(KeepStart - FreeStart))
+               );
+      }
+
+      if (KeepEnd > FreeStart) {
+        Kept     += EFI_SIZE_TO_PAGES (
+                      (UINTN)(KeepEnd - MAX (FreeStart, KeepStart))
+                      );
+        FreeStart = KeepEnd;
+      }
+    }
+
+    if (ArenaEnd > FreeStart) {
+      gBS->FreePages (
+             FreeStart,
+             EFI_SIZE_TO_PAGES ((UINTN)(ArenaEnd - FreeStart))
+             );
+    }
+
+    Arena->Pages = 0;
+  }
+
+  if (!ReleaseAll) {
+    DEBUG ((
+      DEBUG_INFO,
+      "%a: kept %Lu AcpiNVS pages\n",
+      __func__,
+      (UINT64)Kept
+      ));
+  }
+}
+
+//
+// LoaderSum8() adds up bytes a UINTN at a time: the even and the odd bytes of
+// each word are accumulated separately in 16-bit lanes, which can take
+// SUM8_WORDS_PER_BATCH words (2 * 255 per lane and word) before they have to
+// be folded into the 8-bit result. Only plain integer arithmetic is used, so
+// this works the same on every architecture that OVMF/ArmVirtQemu builds for,
+// and in every phase, without touching vector register state.
+//
+#define SUM8_WORDS_PER_BATCH  128
+#define SUM8_LANE_MASK        (MAX_UINTN / 0xFFFF * 0xFF)
+
+/**
+  Sum the bytes in a buffer, modulo 256. Equivalent to CalculateSum8(), but
+  processes a UINTN per iteration.
+
+  @param[in] Buffer  The buffer to sum.
+
+  @param[in] Length  The number of bytes in Buffer.
+
+  @return  The sum of the bytes in Buffer, modulo 256.
+**/
+STATIC
+UINT8
+LoaderSum8 (
+  IN CONST UINT8  *Buffer,
+  IN UINTN        Length
+  )
+{
+  CONST UINTN  *Word;
+  UINTN        WordCount;
+  UINTN        Batch;
+  UINTN        Lanes;
+  UINTN        Shift;
+  UINT8        Sum;
+
+  Sum = 0;
+  while ((Length > 0) && (((UINTN)Buffer & (sizeof (UINTN) - 1)) != 0)) {
+    Sum = (UINT8)(Sum + *Buffer++);
+    --Length;
+  }
+
+  Word      = (CONST UINTN *)Buffer;
+  WordCount = Length / sizeof (UINTN);
+  while (WordCount > 0) {
+    Batch      = MIN (WordCount, SUM8_WORDS_PER_BATCH);
+    WordCount -= Batch;
+    Lanes      = 0;
+    while (Batch > 0) {
+      Lanes += (*Word & SUM8_LANE_MASK) + ((*Word >> 8) & SUM8_LANE_MASK);
+      ++Word;
+      --Batch;
+    }
+
+    for (Shift = 0; Shift < sizeof (UINTN) * 8; Shift += 16) {
+      Sum = (UINT8)(Sum + (UINT8)(Lanes >> Shift));
+    }
+  }
+
+  Buffer  = (CONST UINT8 *)Word;
+  Length %= sizeof (UINTN);
+  while (Length > 0) {
+    Sum = (UINT8)(Sum + *Buffer++);
+    --Length;
+  }
+
+  return Sum;
+}
+
+/**
+  Account for the first pass modifying a blob. If the modified bytes may fall
+  inside a range that has been checksummed before, the checksums recorded for
+  the blob can no longer be trusted by IsSummedRange().
+
+  @param[in,out] Blob  The blob being modified.
+
+  @param[in] Offset    The offset of the first modified byte in Blob.
+**/
+STATIC
+VOID
+NoteBlobWrite (
+  IN OUT BLOB   *Blob,
+  IN     UINTN  Offset
+  )
+{
+  if (Offset < Blob->ChecksummedEnd) {
+    Blob->ChecksumsStale = TRUE;
+  }
+}
+
+/**
+  Tell whether a range of a blob is known to sum to zero, because the first
+  pass has stored a checksum for exactly that range, and has not modified the
+  blob behind the checksum's back since.
+
+  @param[in] Script     The LOADER_SCRIPT being processed.
+
+  @param[in] BlobIndex  The index of the blob in Script->Blobs.
+
+  @param[in] Start      The offset of the range in the blob.
+
+  @param[in] Length     The size of the range.
+
+  @retval TRUE   The range sums to zero.
+
+  @retval FALSE  The range has to be summed to find out.
+**/
+STATIC
+BOOLEAN
+IsSummedRange (
+  IN CONST LOADER_SCRIPT  *Script,
+  IN UINT32               BlobIndex,
+  IN UINTN                Start,
+  IN UINTN                Length
+  )
+{
+  LOADER_ADD_CHECKSUM  Key;
+  UINTN                Low;
+  UINTN                High;
+  UINTN                Middle;
+  INTN                 Order;
+
+  if (Script->Blobs[BlobIndex].ChecksumsStale ||
+      (Start > MAX_UINT32) || (Length > MAX_UINT32))
+  {
+    return FALSE;
+  }
+
+  Key.Blob   = BlobIndex;
+  Key.Start  = (UINT32)Start;
+  Key.Length = (UINT32)Length;
+
+  Low  = 0;
+  High = Script->SummedRangeCount;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    Order  = CompareSummedRange (&Key, &Script->SummedRanges[Middle]);
+    if (Order == 0) {
+      return TRUE;
+    }
+
+    if (Order < 0) {
+      High = Middle;
+    } else {
+      Low = Middle + 1;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Process a decoded QEMU_LOADER_ADD_POINTER command.
+
+  @param[in] AddPointer  The decoded QEMU_LOADER_ADD_POINTER command to process.
+
+  @param[in] Blobs       The BLOB array of the decoded script.
+
+  @retval EFI_PROTOCOL_ERROR  The pointer to relocate has invalid value, or the
+                              relocated pointer value is not representable in
+                              the given pointer size.
+
+  @retval EFI_SUCCESS         The pointer field inside the pointer blob has
+                              been relocated.
+**/
+STATIC
+EFI_STATUS
+/**
+ * @brief Relocates a pointer field within a blob to reference another blob's memory.
+ *
+ * Processes a decoded QEMU_LOADER_ADD_POINTER command by updating a pointer field in the specified blob to point to the absolute address of another blob, offset by the original pointer value. The location and size of the pointer field have been validated by DecodeCmdAddPointer(); this function checks the pointer value and ensures the relocated pointer is representable.
+ *
+ * @param AddPointer The decoded loader command describing the pointer relocation.
+ * @param Blobs The BLOB array of the decoded script.
+ * @return EFI_STATUS EFI_SUCCESS on success, or EFI_PROTOCOL_ERROR on an invalid pointer value.
+ */
+EFIAPI
+ProcessCmdAddPointer (
+  IN     CONST LOADER_ADD_POINTER  *AddPointer,
+  IN OUT BLOB                      *Blobs
+  )
+{
+  BLOB        *Blob;
+  CONST BLOB  *Blob2;
+  UINT8       *PointerField;
+  UINT64      PointerValue;
+
+  Blob         = &Blobs[AddPointer->PointerBlob];
+  Blob2        = &Blobs[AddPointer->PointeeBlob];
+  PointerField = Blob->Base + AddPointer->PointerOffset;
+  PointerValue = 0;
+  CopyMem (&PointerValue, PointerField, AddPointer->PointerSize);
+  if (PointerValue >= Blob2->Size) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: invalid pointer value in \"%a\"\n",
+      __func__,
+      Blob->File
+      ));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  //
+  // The memory allocation system ensures that the address of the byte past the
+  // last byte of any allocated object is expressible (no wraparound).
+  //
+  ASSERT ((UINTN)Blob2->Base <= MAX_ADDRESS - Blob2->Size);
+
+  PointerValue += (UINT64)(UINTN)Blob2->Base;
+  if ((AddPointer->PointerSize < 8) &&
+      (RShiftU64 (PointerValue, AddPointer->PointerSize * 8) != 0))
+  {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: relocated pointer value unrepresentable in "
+      "\"%a\"\n",
+      __func__,
+      Blob->File
+      ));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  NoteBlobWrite (Blob, AddPointer->PointerOffset);
+  CopyMem (PointerField, &PointerValue, AddPointer->PointerSize);
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: PointerFile=\"%a\" PointeeFile=\"%a\" "
+    "PointerOffset=0x%x PointerSize=%d\n",
+    __func__,
+    Blob->File,
+    Blob2->File,
+    AddPointer->PointerOffset,
+    AddPointer->PointerSize
+    ));
+  return EFI_SUCCESS;
+}
+
+/**
+  Process a decoded QEMU_LOADER_ADD_CHECKSUM command.
+
+  @param[in] AddChecksum  The decoded QEMU_LOADER_ADD_CHECKSUM command to
+                          process.
+
+  @param[in] Blobs        The BLOB array of the decoded script.
+
+  @retval EFI_SUCCESS  The requested range has been checksummed.
+**/
+STATIC
+EFI_STATUS
+/**
+ * @brief Computes and stores an 8-bit checksum over a specified range in a tracked blob.
+ *
+ * The range and the result offset have been validated by DecodeCmdAddChecksum(); this function computes the checksum over the given range, and writes the result at the specified offset within the blob.
+ *
+ * @retval EFI_SUCCESS            The checksum was computed and stored successfully.
+ */
+EFIAPI
+ProcessCmdAddChecksum (
+  IN     CONST LOADER_ADD_CHECKSUM  *AddChecksum,
+  IN OUT BLOB                       *Blobs
+  )
+{
+  BLOB   *Blob;
+  UINT8  Sum;
+
+  Blob = &Blobs[AddChecksum->Blob];
+  if (!Blob->Referenced) {
+    //
+    // The blob has not been downloaded, because nothing can consume it.
+    //
+    return EFI_SUCCESS;
+  }
+
+  NoteBlobWrite (Blob, AddChecksum->ResultOffset);
+
+  //
+  // Clear the result byte first, so that a range that contains it sums to zero
+  // afterwards even if QEMU left a non-zero value there. IsSummedRange() relies
+  // on that.
+  //
+  Blob->Base[AddChecksum->ResultOffset] = 0;
+  Sum  = LoaderSum8 (Blob->Base + AddChecksum->Start, AddChecksum->Length);
+  Blob->Base[AddChecksum->ResultOffset] = (UINT8)(0x100 - Sum);
+  Blob->ChecksummedEnd = MAX (
+                           Blob->ChecksummedEnd,
+                           (UINTN)AddChecksum->Start + AddChecksum->Length
+                           );
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: File=\"%a\" ResultOffset=0x%x Start=0x%x "
+    "Length=0x%x\n",
+    __func__,
+    Blob->File,
+    AddChecksum->ResultOffset,
+    AddChecksum->Start,
+    AddChecksum->Length
+    ));
+  return EFI_SUCCESS;
+}
+
+//
+// The pointer writes captured by the first pass for S3 resume. The last
+// CONDENSED_WRITE is kept back until it is known that the next WritePointer
+// command cannot be coalesced with it.
+//
+typedef struct {
+  S3_CONTEXT         *Context;  // NULL if S3 is disabled.
+  CONDENSED_WRITE    Pending;
+} S3_WRITES;
+
+/**
+  Save the pending CONDENSED_WRITE of an S3_WRITES, if any, to its S3_CONTEXT.
+
+  @param[in,out] S3Writes  The S3_WRITES to flush. Its Context must not be
+                           NULL.
+
+  @retval EFI_SUCCESS  There was nothing to save, or it has been saved.
+
+  @return              Error codes from
+                       SaveCondensedWritePointerToS3Context().
+**/
+STATIC
+EFI_STATUS
+S3WritesFlush (
+  IN OUT S3_WRITES  *S3Writes
+  )
+{
+  CONDENSED_WRITE  *Pending;
+  EFI_STATUS       Status;
+
+  Pending = &S3Writes->Pending;
+  if (Pending->PointerSize == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Status = SaveCondensedWritePointerToS3Context (
+             S3Writes->Context,
+             Pending->PointerItem,
+             Pending->PointerSize,
+             Pending->PointerOffset,
+             Pending->PointerValue
+             );
+  if (!EFI_ERROR (Status)) {
+    Pending->PointerSize = 0;
+  }
+
+  return Status;
+}
+
+/**
+  Capture a pointer write for S3 resume, coalescing it with the pending one if
+  possible.
+
+  @param[in,out] S3Writes  The S3_WRITES to record the pointer write in. Its
+                           Context must not be NULL.
+
+  @param[in] PointerItem   The fw_cfg item to write.
+
+  @param[in] PointerSize   The number of bytes to write.
+
+  @param[in] PointerOffset The offset of the write in the fw_cfg item.
+
+  @param[in] PointerValue  The value to write; representable in PointerSize
+                           bytes.
+
+  @retval EFI_SUCCESS  The pointer write has been recorded.
+
+  @return              Error codes from S3WritesFlush().
+**/
+STATIC
+EFI_STATUS
+S3WritesRecord (
+  IN OUT S3_WRITES  *S3Writes,
+  IN     UINT16     PointerItem,
+  IN     UINT8      PointerSize,
+  IN     UINT32     PointerOffset,
+  IN     UINT64     PointerValue
+  )
+{
+  CONDENSED_WRITE  *Pending;
+  EFI_STATUS       Status;
+
+  Pending = &S3Writes->Pending;
+  if (CondensedWriteAppend (
+        Pending,
+        PointerItem,
+        PointerSize,
+        PointerOffset,
+        PointerValue
+        ))
+  {
+    return EFI_SUCCESS;
+  }
+
+  Status = S3WritesFlush (S3Writes);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Pending->PointerItem   = PointerItem;
+  Pending->PointerSize   = PointerSize;
+  Pending->PointerOffset = PointerOffset;
+  Pending->PointerValue  = PointerValue;
+  return EFI_SUCCESS;
+}
+
+/**
+ * @brief Processes a decoded QEMU_LOADER_WRITE_POINTER command to update a pointer in a writable fw_cfg file.
+ *
+ * The command has been validated by DecodeCmdWritePointer(). This function computes the absolute pointer value, and writes it into the specified offset in the fw_cfg file. If S3 resume is enabled, the pointer write is also recorded for replay after S3 resume. Marks the referenced blob as unreleasable after the pointer is written.
+ *
+ * @param[in] WritePointer   The decoded QEMU_LOADER_WRITE_POINTER command to process.
+ * @param[in,out] Blobs      The BLOB array of the decoded script.
+ * @param[in,out] S3Writes   The S3_WRITES for capturing pointer writes for S3 resume; its Context is NULL if S3 is disabled.
+ *
+ * @retval EFI_SUCCESS           The pointer was written successfully, and recorded for S3 resume if applicable.
+ * @retval EFI_PROTOCOL_ERROR    The pointer value is not representable in the given pointer size.
+ * @return                       Error codes from S3WritesRecord() if S3 context recording fails.
+ */
+STATIC
+EFI_STATUS
+ProcessCmdWritePointer (
+  IN     CONST LOADER_WRITE_POINTER  *WritePointer,
+  IN OUT       BLOB                  *Blobs,
+  IN OUT       S3_WRITES             *S3Writes
+  )
+{
+  BLOB    *PointeeBlob;
+  UINT64  PointerValue;
+
+  PointeeBlob = &Blobs[WritePointer->PointeeBlob];
+
+  //
+  // The memory allocation system ensures that the address of the byte past the
+  // last byte of any allocated object is expressible (no wraparound).
+  //
+  ASSERT ((UINTN)PointeeBlob->Base <= MAX_ADDRESS - PointeeBlob->Size);
+
+  PointerValue = WritePointer->PointeeOffset +
+                 (UINT64)(UINTN)PointeeBlob->Base;
+  if ((WritePointer->PointerSize < 8) &&
+      (RShiftU64 (PointerValue, WritePointer->PointerSize * 8) != 0))
+  {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: pointer value unrepresentable in fw_cfg item 0x%x\n",
+      __func__,
+      WritePointer->PointerItem
+      ));
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  //
+  // If S3 is enabled, we have to capture the below fw_cfg actions in condensed
+  // form, to be replayed during S3 resume.
+  //
+  if (S3Writes->Context != NULL) {
+    EFI_STATUS  SaveStatus;
+
+    SaveStatus = S3WritesRecord (
+                   S3Writes,
+                   WritePointer->PointerItem,
+                   WritePointer->PointerSize,
+                   WritePointer->PointerOffset,
+                   PointerValue
+                   );
+    if (EFI_ERROR (SaveStatus)) {
+      return SaveStatus;
+    }
+  }
+
+  QemuFwCfgSelectItem ((FIRMWARE_CONFIG_ITEM)WritePointer->PointerItem);
+  QemuFwCfgSkipBytes (WritePointer->PointerOffset);
+  QemuFwCfgWriteBytes (WritePointer->PointerSize, &PointerValue);
+
+  //
+  // Because QEMU has now learned PointeeBlob->Base, we must mark PointeeBlob
+  // as unreleasable, for the case when the whole linker/loader script is
+  // handled successfully.
+  //
+  PointeeBlob->HostsOnlyTableData = FALSE;
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: PointerItem=0x%x PointeeFile=\"%a\" "
+    "PointerOffset=0x%x PointeeOffset=0x%x PointerSize=%d\n",
+    __func__,
+    WritePointer->PointerItem,
+    PointeeBlob->File,
+    WritePointer->PointerOffset,
+    WritePointer->PointeeOffset,
+    WritePointer->PointerSize
+    ));
+  return EFI_SUCCESS;
+}
+
+/**
+ * @brief Reverts a QEMU_LOADER_WRITE_POINTER command by zeroing the pointer field in the specified fw_cfg file.
+ *
+ * This function clears a previously written guest memory pointer in a fw_cfg file, effectively undoing the effect of a QEMU_LOADER_WRITE_POINTER command that was successfully processed earlier.
+ *
+ * @param[in] WritePointer Pointer to the decoded QEMU_LOADER_WRITE_POINTER command describing the pointer to be zeroed.
+ */
+STATIC
+VOID
+UndoCmdWritePointer (
+  IN CONST LOADER_WRITE_POINTER  *WritePointer
+  )
+{
+  UINT64  PointerValue;
+
+  PointerValue = 0;
+  QemuFwCfgSelectItem ((FIRMWARE_CONFIG_ITEM)WritePointer->PointerItem);
+  QemuFwCfgSkipBytes (WritePointer->PointerOffset);
+  QemuFwCfgWriteBytes (WritePointer->PointerSize, &PointerValue);
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "%a: PointerItem=0x%x PointerOffset=0x%x PointerSize=%d\n",
+    __func__,
+    WritePointer->PointerItem,
+    WritePointer->PointerOffset,
+    WritePointer->PointerSize
+    ));
+}
+
+//
+// Deduplication of the pointer targets examined by the second pass. Every
+// AddPointer target lies inside its pointee blob, so a target is identified by
+// (blob index, offset in blob). A single pool allocation holds, for each blob,
+// the number of the bit that stands for offset 0 in that blob, followed by a
+// bitmap with one bit for each byte of each blob. Marking a target as seen, and
+// reverting that, are thus bit operations rather than ORDERED_COLLECTION node
+// allocations and releases, and the whole structure is torn down with one
+// FreePool().
+//
+typedef struct {
+  UINTN    *BitBase; // Indexed by blob number.
+  UINT8    *Bits;
+} SEEN_POINTERS;
+
+/**
+  Allocate an empty SEEN_POINTERS structure for the blobs of the decoded
+  script.
+
+  @param[out] SeenPointers  The SEEN_POINTERS structure to initialize.
+
+  @param[in] Script         The decoded linker/loader script.
+
+  @retval EFI_SUCCESS           SeenPointers has been initialized.
+
+  @retval EFI_OUT_OF_RESOURCES  Pool allocation failed.
+**/
+STATIC
+EFI_STATUS
+SeenPointersInit (
+  OUT SEEN_POINTERS        *SeenPointers,
+  IN  CONST LOADER_SCRIPT  *Script
+  )
+{
+  UINTN  BaseCount;
+  UINTN  BitCount;
+  UINTN  Index;
+
+  BitCount = 0;
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    BitCount += Script->Blobs[Index].Size;
+  }
+
+  BaseCount             = MAX (Script->BlobCount, 1);
+  SeenPointers->BitBase = AllocateZeroPool (
+                            BaseCount * sizeof *SeenPointers->BitBase +
+                            (BitCount + 7) / 8
+                            );
+  if (SeenPointers->BitBase == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  mLoaderStats[LoaderStatInstallTables].PoolAllocations++;
+
+  SeenPointers->Bits = (UINT8 *)(SeenPointers->BitBase + BaseCount);
+  BitCount           = 0;
+  for (Index = 0; Index < Script->BlobCount; ++Index) {
+    SeenPointers->BitBase[Index] = BitCount;
+    BitCount                    += Script->Blobs[Index].Size;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Release a SEEN_POINTERS structure, forgetting all targets at once.
+
+  @param[in] SeenPointers  The SEEN_POINTERS structure to tear down.
+**/
+STATIC
+VOID
+SeenPointersUninit (
+  IN SEEN_POINTERS  *SeenPointers
+  )
+{
+  FreePool (SeenPointers->BitBase);
+}
+
+/**
+  Mark a pointer target as seen.
+
+  @param[in,out] SeenPointers  The SEEN_POINTERS structure to update.
+
+  @param[in] BlobNumber        The index of the blob that the target lies in.
+
+  @param[in] Offset            The offset of the target in the blob.
+
+  @retval TRUE   The target had not been seen before, and it has been marked.
+
+  @retval FALSE  The target had been seen before.
+**/
+STATIC
+BOOLEAN
+SeenPointersInsert (
+  IN OUT SEEN_POINTERS  *SeenPointers,
+  IN     UINTN          BlobNumber,
+  IN     UINTN          Offset
+  )
+{
+  UINTN  Bit;
+  UINT8  Mask;
+
+  Bit  = SeenPointers->BitBase[BlobNumber] + Offset;
+  Mask = (UINT8)(1 << (Bit % 8));
+  if ((SeenPointers->Bits[Bit / 8] & Mask) != 0) {
+    return FALSE;
+  }
+
+  SeenPointers->Bits[Bit / 8] |= Mask;
+  return TRUE;
+}
+
+/**
+  Revert SeenPointersInsert() for a target.
+
+  @param[in,out] SeenPointers  The SEEN_POINTERS structure to update.
+
+  @param[in] BlobNumber        The index of the blob that the target lies in.
+
+  @param[in] Offset            The offset of the target in the blob.
+**/
+STATIC
+VOID
+SeenPointersDelete (
+  IN OUT SEEN_POINTERS  *SeenPointers,
+  IN     UINTN          BlobNumber,
+  IN     UINTN          Offset
+  )
+{
+  UINTN  Bit;
+
+  Bit                          = SeenPointers->BitBase[BlobNumber] + Offset;
+  SeenPointers->Bits[Bit / 8] &= (UINT8) ~(1 << (Bit % 8));
+}
+
+//
+// We'll be saving the keys of installed tables so that we can roll them back
+// in case of failure. Each AddPointer command identifies at most one table,
+// and the VBIOS SSDT and the statistics table come on top, so the key array is
+// sized from the number of AddPointer commands counted by
+// DecodeLoaderScript(); no fixed limit applies.
+//
+typedef struct {
+  UINTN    *Keys;     // AcpiProtocol-internal keys of the installed tables.
+  UINTN    Count;     // The number of keys stored in Keys.
+  UINTN    Capacity;  // The number of elements allocated for Keys.
+} INSTALLED_TABLES;
+
+/**
+  Process a QEMU_LOADER_ADD_POINTER command in order to see if its target byte
+  array is an ACPI table, and if so, install it.
+
+  This function assumes that the entire QEMU linker/loader command file has
+  been processed successfully in a prior first pass.
+
+  @param[in] AddPointer        The decoded QEMU_LOADER_ADD_POINTER command to
+                               process.
+
+  @param[in,out] Script        The decoded script. Its blobs have been
+                               processed by the first pass.
+
+  @param[in] AcpiProtocol      The ACPI table protocol used to install tables.
+
+  @param[in,out] Installed     The INSTALLED_TABLES that the function will
+                               append the AcpiProtocol-internal key of the
+                               ACPI table to, if the AddPointer command
+                               identified an ACPI table that is different from
+                               RSDT and XSDT.
+
+  @param[in,out] SeenPointers  The SEEN_POINTERS structure tracking the
+                               targets that have been pointed-to by
+                               QEMU_LOADER_ADD_POINTER commands thus far. If a
+                               target address is encountered for the first
+                               time, and it identifies an ACPI table that is
+                               different from RDST and XSDT, the table is
+                               installed. If a target address is seen for the
+                               second or later times, it is skipped without
+                               taking any action.
+
+  @retval EFI_OUT_OF_RESOURCES   The AddPointer command identified an ACPI
+                                 table different from RSDT and XSDT, but there
+                                 was no more room in Installed. (This cannot
+                                 happen if Installed has been sized for every
+                                 AddPointer command of the script.)
+
+  @retval EFI_SUCCESS            AddPointer has been processed. Either its
+                                 absolute target address has been encountered
+                                 before, or an ACPI table different from RSDT
+                                 and XSDT has been installed (reflected by
+                                 Installed), or RSDT or
+                                 XSDT has been identified but not installed, or
+                                 the fw_cfg blob pointed-into by AddPointer has
+                                 been marked as hosting something else than
+                                 just direct ACPI table contents.
+
+  @return                        Error codes returned by
+                                 AcpiProtocol->InstallAcpiTable().
+**/
+STATIC
+EFI_STATUS
+/**
+ * @brief Processes a QEMU_LOADER_ADD_POINTER command in the second pass to identify and install ACPI tables.
+ *
+ * Examines the pointer target specified by the loader command to determine if it references a valid ACPI table or FACS structure. If a valid table is found (excluding RSDT and XSDT), installs it using the EFI_ACPI_TABLE_PROTOCOL and tracks the installation to prevent duplicates. Marks blobs as opaque if no ACPI table is found. Handles resource limits and avoids reprocessing already seen pointers.
+ *
+ * @param AddPointer The decoded loader command describing the pointer relocation.
+ * @param Script The decoded script, after the first pass.
+ * @param AcpiProtocol ACPI table protocol for table installation.
+ * @param Installed The keys of the installed tables; appended to on success.
+ * @param SeenPointers Bitmap tracking already processed pointer targets.
+ * @return EFI_SUCCESS on success, or an appropriate EFI error code on failure.
+ */
+EFIAPI
+Process2ndPassCmdAddPointer (
+  IN     CONST LOADER_ADD_POINTER  *AddPointer,
+  IN OUT LOADER_SCRIPT             *Script,
+  IN     EFI_ACPI_TABLE_PROTOCOL   *AcpiProtocol,
+  IN OUT INSTALLED_TABLES          *Installed,
+  IN OUT SEEN_POINTERS             *SeenPointers
+  )
+{
+  CONST BLOB                                          *Blob;
+  BLOB                                                *Blob2;
+  CONST UINT8                                         *PointerField;
+  UINT64                                              PointerValue;
+  UINTN                                               Blob2Remaining;
+  UINTN                                               TableSize;
+  CONST EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE  *Facs;
+  CONST EFI_ACPI_DESCRIPTION_HEADER                   *Header;
+  EFI_STATUS                                          Status;
+
+  Blob         = &Script->Blobs[AddPointer->PointerBlob];
+  Blob2        = &Script->Blobs[AddPointer->PointeeBlob];
+  PointerField = Blob->Base + AddPointer->PointerOffset;
+  PointerValue = 0;
+  CopyMem (&PointerValue, PointerField, AddPointer->PointerSize);
+
+  //
+  // We assert that PointerValue falls inside Blob2's contents. This is ensured
+  // by the Blob2->Size check and later checks in ProcessCmdAddPointer().
   //
   Blob2Remaining = (UINTN)Blob2->Base;
   ASSERT (PointerValue >= Blob2Remaining);
   Blob2Remaining += Blob2->Size;
   ASSERT (PointerValue < Blob2Remaining);
 
-  Status = OrderedCollectionInsert (
-             SeenPointers,
-             &SeenPointerEntry, // for reverting insertion in error case
-             (VOID *)(UINTN)PointerValue
-             );
-  if (EFI_ERROR (Status)) {
-    if (Status == RETURN_ALREADY_STARTED) {
-      //
-      // Already seen this pointer, don't try to process it again.
-      //
-      DEBUG ((
-        DEBUG_VERBOSE,
-        "%a: PointerValue=0x%Lx already processed, skipping.\n",
-        __func__,
-        PointerValue
-        ));
-      Status = EFI_SUCCESS;
-    }
-
-    return Status;
+  if (!SeenPointersInsert (
+         SeenPointers,
+         AddPointer->PointeeBlob,
+         (UINTN)PointerValue - (UINTN)Blob2->Base
+         ))
+  {
+    //
+    // Already seen this pointer, don't try to process it again.
+    //
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a: PointerValue=0x%Lx already processed, skipping.\n",
+      __func__,
+      PointerValue
+      ));
+    return EFI_SUCCESS;
   }
 
   Blob2Remaining -= (UINTN)PointerValue;
@@ -1001,112 +2601,788 @@ Process2ndPassCmdAddPointer (
     "%a: checking for ACPI header in \"%a\" at 0x%Lx "
     "(remaining: 0x%Lx): ",
     __func__,
-    AddPointer->PointeeFile,
+    Blob2->File,
     PointerValue,
     (UINT64)Blob2Remaining
     ));
 
-  TableSize = 0;
+  TableSize = 0;
+
+  //
+  // To make our job simple, the FACS has a custom header. Sigh.
+  //
+  if (sizeof *Facs <= Blob2Remaining) {
+    Facs = (EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE *)(UINTN)PointerValue;
+
+    if ((Facs->Length >= sizeof *Facs) &&
+        (Facs->Length <= Blob2Remaining) &&
+        (Facs->Signature ==
+         EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE_SIGNATURE))
+    {
+      DEBUG ((
+        DEBUG_VERBOSE,
+        "found \"%-4.4a\" size 0x%x\n",
+        (CONST CHAR8 *)&Facs->Signature,
+        Facs->Length
+        ));
+      TableSize = Facs->Length;
+    }
+  }
+
+  //
+  // check for the uniform tables
+  //
+  if ((TableSize == 0) && (sizeof *Header <= Blob2Remaining)) {
+    Header = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)PointerValue;
+
+    if ((Header->Length >= sizeof *Header) &&
+        (Header->Length <= Blob2Remaining) &&
+        (IsSummedRange (
+           Script,
+           AddPointer->PointeeBlob,
+           (UINTN)PointerValue - (UINTN)Blob2->Base,
+           Header->Length
+           ) ||
+         (LoaderSum8 ((CONST UINT8 *)Header, Header->Length) == 0)))
+    {
+      //
+      // This looks very much like an ACPI table from QEMU:
+      // - Length field consistent with both ACPI and containing blob size
+      // - checksum is correct (as stored by the first pass, or recomputed)
+      //
+      DEBUG ((
+        DEBUG_VERBOSE,
+        "found \"%-4.4a\" size 0x%x\n",
+        (CONST CHAR8 *)&Header->Signature,
+        Header->Length
+        ));
+      TableSize = Header->Length;
+
+      //
+      // Skip RSDT and XSDT because those are handled by
+      // EFI_ACPI_TABLE_PROTOCOL automatically.
+      if ((Header->Signature ==
+           EFI_ACPI_1_0_ROOT_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) ||
+          (Header->Signature ==
+           EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE))
+      {
+        return EFI_SUCCESS;
+      }
+    }
+  }
+
+  if (TableSize == 0) {
+    DEBUG ((DEBUG_VERBOSE, "not found; marking fw_cfg blob as opaque\n"));
+    Blob2->HostsOnlyTableData = FALSE;
+    return EFI_SUCCESS;
+  }
+
+  if (Installed->Count == Installed->Capacity) {
+    ASSERT (FALSE);
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: can't install more than %Lu tables\n",
+      __func__,
+      (UINT64)Installed->Capacity
+      ));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto RollbackSeenPointer;
+  }
+
+  Status = AcpiProtocol->InstallAcpiTable (
+                           AcpiProtocol,
+                           (VOID *)(UINTN)PointerValue,
+                           TableSize,
+                           &Installed->Keys[Installed->Count]
+                           );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: InstallAcpiTable(): %r\n",
+      __func__,
+      Status
+      ));
+    goto RollbackSeenPointer;
+  }
+
+  ++Installed->Count;
+  return EFI_SUCCESS;
+
+RollbackSeenPointer:
+  SeenPointersDelete (
+    SeenPointers,
+    AddPointer->PointeeBlob,
+    (UINTN)PointerValue - (UINTN)Blob2->Base
+    );
+  return Status;
+}
+
+//
+// Minimal AML writer, used to generate the SSDT that exposes the VBIOS image.
+// Objects are emitted front to back; the PkgLength of an open package is
+// fixed up, in its shortest encoding, when the package is closed. If Buffer is
+// NULL, the builder only computes the length of the output, so that the caller
+// can size the buffer with a dry run.
+//
+#define AML_MAX_PKG_DEPTH  8
+
+typedef struct {
+  UINT8    *Buffer;                      // Output, or NULL for a dry run.
+  UINTN    Length;                       // The number of bytes emitted.
+  UINTN    PkgStart[AML_MAX_PKG_DEPTH];  // Offsets of the open PkgLengths.
+  UINTN    PkgDepth;
+} AML_BUILDER;
+
+/**
+  Append bytes to the AML output.
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+
+  @param[in] Data         The bytes to append.
+
+  @param[in] Size         The number of bytes to append.
+**/
+STATIC
+VOID
+AmlAppend (
+  IN OUT AML_BUILDER  *Builder,
+  IN     CONST VOID   *Data,
+  IN     UINTN        Size
+  )
+{
+  if (Builder->Buffer != NULL) {
+    CopyMem (Builder->Buffer + Builder->Length, Data, Size);
+  }
+
+  Builder->Length += Size;
+}
+
+/**
+  Append a single byte (typically an opcode) to the AML output.
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+
+  @param[in] Byte         The byte to append.
+**/
+STATIC
+VOID
+AmlByte (
+  IN OUT AML_BUILDER  *Builder,
+  IN     UINT8        Byte
+  )
+{
+  AmlAppend (Builder, &Byte, sizeof Byte);
+}
+
+/**
+  Encode a PkgLength value.
+
+  @param[in] Value     The value to encode; it must be below 2^28.
+
+  @param[out] Encoded  The encoded value, at most 4 bytes.
+
+  @return  The number of bytes in Encoded.
+**/
+STATIC
+UINTN
+AmlEncodePkgLength (
+  IN  UINT32  Value,
+  OUT UINT8   Encoded[4]
+  )
+{
+  UINTN  Size;
+  UINTN  Index;
+
+  ASSERT (Value < BIT28);
+
+  if (Value < BIT6) {
+    Encoded[0] = (UINT8)Value;
+    return 1;
+  }
+
+  Size = (Value < BIT12) ? 2 : (Value < BIT20) ? 3 : 4;
+
+  Encoded[0] = (UINT8)(((Size - 1) << 6) | (Value & 0xF));
+  for (Index = 1; Index < Size; ++Index) {
+    Encoded[Index] = (UINT8)(Value >> (4 + 8 * (Index - 1)));
+  }
+
+  return Size;
+}
+
+/**
+  Open a package: reserve room for its PkgLength, to be filled in by
+  AmlPkgEnd().
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+**/
+STATIC
+VOID
+AmlPkgBegin (
+  IN OUT AML_BUILDER  *Builder
+  )
+{
+  ASSERT (Builder->PkgDepth < AML_MAX_PKG_DEPTH);
+  Builder->PkgStart[Builder->PkgDepth++] = Builder->Length;
+  Builder->Length                       += 4;
+}
+
+/**
+  Close the innermost open package, and encode its PkgLength (which counts
+  itself) in the fewest bytes possible.
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+**/
+STATIC
+VOID
+AmlPkgEnd (
+  IN OUT AML_BUILDER  *Builder
+  )
+{
+  UINTN  Start;
+  UINTN  BodySize;
+  UINTN  Size;
+  UINT8  Encoded[4];
+
+  ASSERT (Builder->PkgDepth > 0);
+  Start    = Builder->PkgStart[--Builder->PkgDepth];
+  BodySize = Builder->Length - Start - 4;
+
+  //
+  // The encoding of the PkgLength is part of the length that it encodes.
+  //
+  Size = 1;
+  while (AmlEncodePkgLength ((UINT32)(BodySize + Size), Encoded) != Size) {
+    ++Size;
+  }
+
+  if (Builder->Buffer != NULL) {
+    CopyMem (
+      Builder->Buffer + Start + Size,
+      Builder->Buffer + Start + 4,
+      BodySize
+      );
+    CopyMem (Builder->Buffer + Start, Encoded, Size);
+  }
+
+  Builder->Length = Start + Size + BodySize;
+}
+
+/**
+  Append a NameString to the AML output.
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+
+  @param[in] Path         The name in ASL notation, for example "VBOS" or
+                          "\\_SB.PCI0.S08". NameSegs shorter than four
+                          characters are padded with underscores.
+**/
+STATIC
+VOID
+AmlNameString (
+  IN OUT AML_BUILDER  *Builder,
+  IN     CONST CHAR8  *Path
+  )
+{
+  CONST CHAR8  *Char;
+  UINTN        SegCount;
+  UINTN        SegSize;
+
+  while ((*Path == AML_ROOT_CHAR) || (*Path == AML_PARENT_PREFIX_CHAR)) {
+    AmlByte (Builder, (UINT8)*Path++);
+  }
+
+  SegCount = (*Path == '\0') ? 0 : 1;
+  for (Char = Path; *Char != '\0'; ++Char) {
+    if (*Char == '.') {
+      ++SegCount;
+    }
+  }
+
+  if (SegCount == 0) {
+    AmlByte (Builder, AML_ZERO_OP); // NullName
+    return;
+  }
+
+  if (SegCount == 2) {
+    AmlByte (Builder, AML_DUAL_NAME_PREFIX);
+  } else if (SegCount > 2) {
+    AmlByte (Builder, AML_MULTI_NAME_PREFIX);
+    AmlByte (Builder, (UINT8)SegCount);
+  }
+
+  while (*Path != '\0') {
+    for (SegSize = 0; (*Path != '\0') && (*Path != '.'); ++SegSize) {
+      ASSERT (SegSize < 4);
+      AmlByte (Builder, (UINT8)*Path++);
+    }
+
+    for ( ; SegSize < 4; ++SegSize) {
+      AmlByte (Builder, '_');
+    }
+
+    if (*Path == '.') {
+      ++Path;
+    }
+  }
+}
+
+/**
+  Append an Integer, in its shortest encoding, to the AML output.
+
+  @param[in,out] Builder  The AML_BUILDER to append to.
+
+  @param[in] Value        The value to append. AML Integers are 32 bits wide
+                          in the guest's namespace (see
+                          VROM_REGION_MAX_ADDRESS), so wider values are not
+                          supported.
+**/
+STATIC
+VOID
+AmlInteger (
+  IN OUT AML_BUILDER  *Builder,
+  IN     UINT32       Value
+  )
+{
+  if (Value <= 1) {
+    AmlByte (Builder, (Value == 0) ? AML_ZERO_OP : AML_ONE_OP);
+  } else if (Value <= MAX_UINT8) {
+    AmlByte (Builder, AML_BYTE_PREFIX);
+    AmlAppend (Builder, &Value, sizeof (UINT8));
+  } else if (Value <= MAX_UINT16) {
+    AmlByte (Builder, AML_WORD_PREFIX);
+    AmlAppend (Builder, &Value, sizeof (UINT16));
+  } else {
+    AmlByte (Builder, AML_DWORD_PREFIX);
+    AmlAppend (Builder, &Value, sizeof (UINT32));
+  }
+}
+
+/**
+  Emit the SSDT that exposes the VBIOS image to the guest OS. In ASL:
+
+    DefinitionBlock ("", "SSDT", 1, "REDHAT", "OVMF    ", 1)
+    {
+      OperationRegion (VBOR, SystemMemory, RegionAddress, RegionSize)
+      Field (VBOR, AnyAcc, NoLock, Preserve)
+      {
+        VBOS, RegionSize * 8
+      }
+
+      Scope (VROM_ACPI_DEVICE_PATH)
+      {
+        Name (RVBS, ImageSize)
+        Method (_ROM, 2, NotSerialized)
+        {
+          Local0 = Arg1
+          If (Local0 > 0x1000) {
+            Local0 = 0x1000
+          }
+          If (!(Arg0 < RVBS)) {
+            Return (Buffer (One) { 0x00 })
+          }
+          If ((Arg0 + Local0) > RVBS) {
+            Local0 = RVBS - Arg0
+          }
+          Return (Mid (VBOS, Arg0, Local0))
+        }
+      }
+    }
+
+  @param[in,out] Builder     The AML_BUILDER to emit the table with. Its
+                             Length must be zero.
+
+  @param[in] RegionAddress   The address of the memory holding the image. It
+                             must be below 4GB; see VROM_REGION_MAX_ADDRESS.
+
+  @param[in] RegionSize      The size of the memory holding the image.
+
+  @param[in] ImageSize       The size of the image.
+**/
+STATIC
+VOID
+AmlEmitVromSsdt (
+  IN OUT AML_BUILDER           *Builder,
+  IN     EFI_PHYSICAL_ADDRESS  RegionAddress,
+  IN     UINTN                 RegionSize,
+  IN     UINTN                 ImageSize
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  Header;
+  UINT8                        Encoded[4];
+
+  ASSERT (Builder->Length == 0);
+  ASSERT (RegionAddress + RegionSize - 1 <= VROM_REGION_MAX_ADDRESS);
+
+  //
+  // Length and Checksum are filled in once the table is complete.
+  //
+  ZeroMem (&Header, sizeof Header);
+  Header.Signature       = SIGNATURE_32 ('S', 'S', 'D', 'T');
+  Header.Revision        = 1;
+  CopyMem (Header.OemId, "REDHAT", sizeof Header.OemId);
+  Header.OemTableId      = SIGNATURE_64 ('O', 'V', 'M', 'F', ' ', ' ', ' ', ' ');
+  Header.OemRevision     = 1;
+  Header.CreatorId       = SIGNATURE_32 ('I', 'N', 'T', 'L');
+  Header.CreatorRevision = 0x20160831;
+  AmlAppend (Builder, &Header, sizeof Header);
+
+  AmlByte (Builder, AML_EXT_OP);
+  AmlByte (Builder, AML_EXT_REGION_OP);
+  AmlNameString (Builder, "VBOR");
+  AmlByte (Builder, 0x00);                              // SystemMemory
+  AmlInteger (Builder, (UINT32)RegionAddress);
+  AmlInteger (Builder, (UINT32)RegionSize);
+
+  AmlByte (Builder, AML_EXT_OP);
+  AmlByte (Builder, AML_EXT_FIELD_OP);
+  AmlPkgBegin (Builder);
+  AmlNameString (Builder, "VBOR");
+  AmlByte (Builder, 0x00);                              // AnyAcc, NoLock,
+                                                        // Preserve
+  AmlNameString (Builder, "VBOS");
+  AmlAppend (
+    Builder,
+    Encoded,
+    AmlEncodePkgLength ((UINT32)(RegionSize * 8), Encoded)   // in bits
+    );
+  AmlPkgEnd (Builder);
+
+  AmlByte (Builder, AML_SCOPE_OP);
+  AmlPkgBegin (Builder);
+  AmlNameString (Builder, VROM_ACPI_DEVICE_PATH);
+
+  AmlByte (Builder, AML_NAME_OP);
+  AmlNameString (Builder, "RVBS");
+  AmlInteger (Builder, (UINT32)ImageSize);
+
+  AmlByte (Builder, AML_METHOD_OP);
+  AmlPkgBegin (Builder);
+  AmlNameString (Builder, "_ROM");
+  AmlByte (Builder, 2);                                 // 2 args,
+                                                        // NotSerialized
+
+  AmlByte (Builder, AML_STORE_OP);                      // Local0 = Arg1
+  AmlByte (Builder, AML_ARG1);
+  AmlByte (Builder, AML_LOCAL0);
+
+  AmlByte (Builder, AML_IF_OP);                         // If (Local0 > 0x1000)
+  AmlPkgBegin (Builder);
+  AmlByte (Builder, AML_LGREATER_OP);
+  AmlByte (Builder, AML_LOCAL0);
+  AmlInteger (Builder, SIZE_4KB);
+  AmlByte (Builder, AML_STORE_OP);                      // Local0 = 0x1000
+  AmlInteger (Builder, SIZE_4KB);
+  AmlByte (Builder, AML_LOCAL0);
+  AmlPkgEnd (Builder);
+
+  AmlByte (Builder, AML_IF_OP);                         // If (!(Arg0 < RVBS))
+  AmlPkgBegin (Builder);
+  AmlByte (Builder, AML_LNOT_OP);
+  AmlByte (Builder, AML_LLESS_OP);
+  AmlByte (Builder, AML_ARG0);
+  AmlNameString (Builder, "RVBS");
+  AmlByte (Builder, AML_RETURN_OP);                     // Return (Buffer (One)
+  AmlByte (Builder, AML_BUFFER_OP);                     //   { 0x00 })
+  AmlPkgBegin (Builder);
+  AmlInteger (Builder, 1);
+  AmlByte (Builder, 0x00);
+  AmlPkgEnd (Builder);
+  AmlPkgEnd (Builder);
+
+  AmlByte (Builder, AML_IF_OP);                         // If ((Arg0 + Local0) >
+  AmlPkgBegin (Builder);                                //   RVBS)
+  AmlByte (Builder, AML_LGREATER_OP);
+  AmlByte (Builder, AML_ADD_OP);
+  AmlByte (Builder, AML_ARG0);
+  AmlByte (Builder, AML_LOCAL0);
+  AmlByte (Builder, AML_ZERO_OP);                       // no Target
+  AmlNameString (Builder, "RVBS");
+  AmlByte (Builder, AML_SUBTRACT_OP);                   // Local0 = RVBS - Arg0
+  AmlNameString (Builder, "RVBS");
+  AmlByte (Builder, AML_ARG0);
+  AmlByte (Builder, AML_LOCAL0);
+  AmlPkgEnd (Builder);
+
+  AmlByte (Builder, AML_RETURN_OP);                     // Return (Mid (VBOS,
+  AmlByte (Builder, AML_MID_OP);                        //   Arg0, Local0))
+  AmlNameString (Builder, "VBOS");
+  AmlByte (Builder, AML_ARG0);
+  AmlByte (Builder, AML_LOCAL0);
+  AmlByte (Builder, AML_ZERO_OP);                       // no Target
+
+  AmlPkgEnd (Builder);                                  // Method
+  AmlPkgEnd (Builder);                                  // Scope
+
+  ASSERT (Builder->PkgDepth == 0);
+  if (Builder->Buffer != NULL) {
+    ((EFI_ACPI_DESCRIPTION_HEADER *)Builder->Buffer)->Length =
+      (UINT32)Builder->Length;
+    ((EFI_ACPI_DESCRIPTION_HEADER *)Builder->Buffer)->Checksum =
+      (UINT8)(0x100 - LoaderSum8 (Builder->Buffer, Builder->Length));
+  }
+}
+
+/**
+  Generate the SSDT that exposes the VBIOS image to the guest OS; see
+  AmlEmitVromSsdt().
+
+  @param[in] RegionAddress  The address of the memory holding the image.
+
+  @param[in] RegionSize     The size of the memory holding the image.
+
+  @param[in] ImageSize      The size of the image.
+
+  @param[out] Ssdt          The table, allocated from pool. The caller is
+                            responsible for freeing it.
+
+  @param[out] SsdtSize      The size of the table.
 
-  //
-  // To make our job simple, the FACS has a custom header. Sigh.
-  //
-  if (sizeof *Facs <= Blob2Remaining) {
-    Facs = (EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE *)(UINTN)PointerValue;
+  @retval EFI_SUCCESS           The table has been generated.
 
-    if ((Facs->Length >= sizeof *Facs) &&
-        (Facs->Length <= Blob2Remaining) &&
-        (Facs->Signature ==
-         EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE_SIGNATURE))
-    {
-      DEBUG ((
-        DEBUG_VERBOSE,
-        "found \"%-4.4a\" size 0x%x\n",
-        (CONST CHAR8 *)&Facs->Signature,
-        Facs->Length
-        ));
-      TableSize = Facs->Length;
-    }
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+
+  @retval EFI_UNSUPPORTED       The region is not below 4GB, so its address
+                                cannot be expressed in the SSDT.
+**/
+STATIC
+EFI_STATUS
+BuildVromSsdt (
+  IN  EFI_PHYSICAL_ADDRESS  RegionAddress,
+  IN  UINTN                 RegionSize,
+  IN  UINTN                 ImageSize,
+  OUT UINT8                 **Ssdt,
+  OUT UINTN                 *SsdtSize
+  )
+{
+  AML_BUILDER  Builder;
+
+  if (RegionAddress + RegionSize - 1 > VROM_REGION_MAX_ADDRESS) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: VBIOS region at 0x%Lx is above 4GB\n",
+      __func__,
+      RegionAddress
+      ));
+    return EFI_UNSUPPORTED;
   }
 
   //
-  // check for the uniform tables
+  // Measure the table with a dry run, then emit it for real.
   //
-  if ((TableSize == 0) && (sizeof *Header <= Blob2Remaining)) {
-    Header = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN)PointerValue;
-
-    if ((Header->Length >= sizeof *Header) &&
-        (Header->Length <= Blob2Remaining) &&
-        (CalculateSum8 ((CONST UINT8 *)Header, Header->Length) == 0))
-    {
-      //
-      // This looks very much like an ACPI table from QEMU:
-      // - Length field consistent with both ACPI and containing blob size
-      // - checksum is correct
-      //
-      DEBUG ((
-        DEBUG_VERBOSE,
-        "found \"%-4.4a\" size 0x%x\n",
-        (CONST CHAR8 *)&Header->Signature,
-        Header->Length
-        ));
-      TableSize = Header->Length;
+  ZeroMem (&Builder, sizeof Builder);
+  AmlEmitVromSsdt (&Builder, RegionAddress, RegionSize, ImageSize);
 
-      //
-      // Skip RSDT and XSDT because those are handled by
-      // EFI_ACPI_TABLE_PROTOCOL automatically.
-      if ((Header->Signature ==
-           EFI_ACPI_1_0_ROOT_SYSTEM_DESCRIPTION_TABLE_SIGNATURE) ||
-          (Header->Signature ==
-           EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE))
-      {
-        return EFI_SUCCESS;
-      }
-    }
+  *SsdtSize      = Builder.Length;
+  Builder.Buffer = AllocatePool (Builder.Length);
+  if (Builder.Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  if (TableSize == 0) {
-    DEBUG ((DEBUG_VERBOSE, "not found; marking fw_cfg blob as opaque\n"));
-    Blob2->HostsOnlyTableData = FALSE;
-    return EFI_SUCCESS;
+  Builder.Length = 0;
+  AmlEmitVromSsdt (&Builder, RegionAddress, RegionSize, ImageSize);
+  ASSERT (Builder.Length == *SsdtSize);
+
+  *Ssdt = Builder.Buffer;
+  return EFI_SUCCESS;
+}
+
+/**
+  Prepare the exposure of the VBIOS image to the guest OS: place the image in
+  reserved memory below 4GB, and generate the SSDT that maps it; see
+  AmlEmitVromSsdt().
+
+  The image comes from the VROM_FW_CFG_FILE fw_cfg file if QEMU offers one, and
+  from VROM_BIN otherwise.
+
+  @param[out] RegionAddress  The address of the reserved memory holding the
+                             image.
+
+  @param[out] RegionSize     The size of the reserved memory holding the image.
+                             Zero if the image does not fit in
+                             VROM_REGION_MAX_SIZE, and is not exposed; no
+                             memory has been reserved then.
+
+  @param[out] Ssdt           The SSDT, allocated from pool. The caller is
+                             responsible for freeing it. NULL if the image is
+                             not exposed.
+
+  @param[out] SsdtSize       The size of the SSDT.
+
+  @retval EFI_SUCCESS  The region and the SSDT have been set up, or the image
+                       is not exposed (see RegionSize).
+
+  @return              Error codes from gBS->AllocatePages() and
+                       BuildVromSsdt(). Nothing has been left allocated.
+**/
+STATIC
+EFI_STATUS
+PrepareVromSsdt (
+  OUT EFI_PHYSICAL_ADDRESS  *RegionAddress,
+  OUT UINTN                 *RegionSize,
+  OUT UINT8                 **Ssdt,
+  OUT UINTN                 *SsdtSize
+  )
+{
+  EFI_STATUS            Status;
+  BOOLEAN               FromFwCfg;
+  FIRMWARE_CONFIG_ITEM  Item;
+  UINTN                 ImageSize;
+  UINT8                 *Region;
+
+  *Ssdt  = NULL;
+  Status = QemuFwCfgFindFile (VROM_FW_CFG_FILE, &Item, &ImageSize);
+  if (!EFI_ERROR (Status) && (ImageSize > 0)) {
+    FromFwCfg = TRUE;
+  } else {
+    FromFwCfg = FALSE;
+    ImageSize = VROM_BIN_LEN;
   }
 
-  if (*NumInstalled == INSTALLED_TABLES_MAX) {
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: VBIOS image of 0x%Lx bytes from %a\n",
+    __func__,
+    (UINT64)ImageSize,
+    FromFwCfg ? "fw_cfg file \"" VROM_FW_CFG_FILE "\"" : "VROM_BIN"
+    ));
+
+  *RegionSize = ALIGN_VALUE (ImageSize, VROM_REGION_ALIGNMENT);
+  if (*RegionSize > VROM_REGION_MAX_SIZE) {
     DEBUG ((
       DEBUG_ERROR,
-      "%a: can't install more than %d tables\n",
+      "%a: VBIOS image of 0x%Lx bytes exceeds VROM_REGION_MAX_SIZE (0x%x), "
+      "not exposing it\n",
       __func__,
-      INSTALLED_TABLES_MAX
+      (UINT64)ImageSize,
+      VROM_REGION_MAX_SIZE
       ));
-    Status = EFI_OUT_OF_RESOURCES;
-    goto RollbackSeenPointer;
+    *RegionSize = 0;
+    return EFI_SUCCESS;
   }
 
-  Status = AcpiProtocol->InstallAcpiTable (
-                           AcpiProtocol,
-                           (VOID *)(UINTN)PointerValue,
-                           TableSize,
-                           &InstalledKey[*NumInstalled]
-                           );
+  *RegionAddress = VROM_REGION_MAX_ADDRESS;
+  Status         = gBS->AllocatePages (
+                          AllocateMaxAddress,
+                          EfiReservedMemoryType,
+                          EFI_SIZE_TO_PAGES (*RegionSize),
+                          RegionAddress
+                          );
   if (EFI_ERROR (Status)) {
-    DEBUG ((
-      DEBUG_ERROR,
-      "%a: InstallAcpiTable(): %r\n",
-      __func__,
-      Status
-      ));
-    goto RollbackSeenPointer;
+    return Status;
   }
 
-  ++*NumInstalled;
-  return EFI_SUCCESS;
+  Region = (UINT8 *)(UINTN)*RegionAddress;
+  if (FromFwCfg) {
+    //
+    // Like the loader blobs, the image comes from QEMU, and the guest OS
+    // consumes it through ACPI.
+    //
+    DownloadAndMeasure (Item, ImageSize, Region);
+  } else {
+    CopyMem (Region, VROM_BIN, ImageSize);
+  }
+
+  ZeroMem (
+    Region + ImageSize,
+    EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (*RegionSize)) - ImageSize
+    );
+
+  Status = BuildVromSsdt (
+             *RegionAddress,
+             *RegionSize,
+             ImageSize,
+             Ssdt,
+             SsdtSize
+             );
+  if (EFI_ERROR (Status)) {
+    *Ssdt = NULL;
+    gBS->FreePages (*RegionAddress, EFI_SIZE_TO_PAGES (*RegionSize));
+  }
 
-RollbackSeenPointer:
-  OrderedCollectionDelete (SeenPointers, SeenPointerEntry, NULL);
   return Status;
 }
 
-/**
+/**
+  Prepare the publication of the loader statistics to the guest OS: allocate
+  the LOADER_STATS_RECORD, and set up the ACPI table that points to it.
+
+  @param[out] Table  The LOADER_STATS_TABLE to set up. It is to be installed
+                     with the other ACPI tables. On failure,
+                     Table->RecordAddress is zero.
+
+  @retval EFI_SUCCESS  The record has been allocated, and Table set up.
+
+  @return              Error codes from gBS->AllocatePages().
+**/
+STATIC
+EFI_STATUS
+PrepareLoaderStatsTable (
+  OUT LOADER_STATS_TABLE  *Table
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  RecordAddress;
+
+  ZeroMem (Table, sizeof *Table);
+  Status = gBS->AllocatePages (
+                  AllocateAnyPages,
+                  EfiReservedMemoryType,
+                  EFI_SIZE_TO_PAGES (sizeof (LOADER_STATS_RECORD)),
+                  &RecordAddress
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem ((VOID *)(UINTN)RecordAddress, sizeof (LOADER_STATS_RECORD));
+
+  Table->Header.Signature       = SIGNATURE_32 ('O', 'E', 'M', 'Q');
+  Table->Header.Length          = sizeof *Table;
+  Table->Header.Revision        = 1;
+  CopyMem (Table->Header.OemId, "REDHAT", sizeof Table->Header.OemId);
+  Table->Header.OemTableId      = SIGNATURE_64 (
+                                    'Q', 'L', 'D', 'R', 'S', 'T', 'A', 'T'
+                                    );
+  Table->Header.OemRevision     = 1;
+  Table->Header.CreatorId       = SIGNATURE_32 ('I', 'N', 'T', 'L');
+  Table->Header.CreatorRevision = 0x20160831;
+  Table->RecordAddress          = RecordAddress;
+  Table->Header.Checksum        = (UINT8)(0x100 - LoaderSum8 (
+                                                   (CONST UINT8 *)Table,
+                                                   sizeof *Table
+                                                   ));
+  return EFI_SUCCESS;
+}
+
+/**
+  Fill in the LOADER_STATS_RECORD set up by PrepareLoaderStatsTable() from the
+  accounting collected by InstallQemuFwCfgTables().
+
+  @param[in] RecordAddress  The address of the LOADER_STATS_RECORD.
+**/
+STATIC
+VOID
+PublishLoaderStats (
+  IN EFI_PHYSICAL_ADDRESS  RecordAddress
+  )
+{
+  LOADER_STATS_RECORD  *Record;
+  LOADER_PHASE         Phase;
+
+  Record             = (LOADER_STATS_RECORD *)(UINTN)RecordAddress;
+  Record->Signature  = LOADER_STATS_SIGNATURE;
+  Record->Length     = sizeof *Record;
+  Record->PhaseCount = LoaderPhaseMax;
+  for (Phase = 0; Phase < LoaderPhaseMax; ++Phase) {
+    Record->PhaseTime[Phase] = GetTimeInNanoSecond (mLoaderPhaseTicks[Phase]);
+  }
+
+  Record->FwCfgBytes      = mLoaderFwCfgBytes;
+  Record->TablesInstalled = (UINT32)mLoaderTablesInstalled;
+}
+
+/**
  * @brief Downloads, processes, and installs ACPI tables from QEMU firmware configuration.
  *
  * Retrieves the QEMU loader script from fw_cfg, parses and executes its commands to allocate memory, patch pointers, compute checksums, and install ACPI tables using the provided ACPI table protocol. Handles S3 resume support, error rollback, and injects an additional SSDT table with VROM data.
@@ -1130,18 +3406,31 @@ InstallQemuFwCfgTables (
   UINTN                     FwCfgSize;
   QEMU_LOADER_ENTRY         *LoaderStart;
   CONST QEMU_LOADER_ENTRY   *LoaderEntry, *LoaderEnd;
-  CONST QEMU_LOADER_ENTRY   *WritePointerSubsetEnd;
+  LOADER_SCRIPT             Script;
+  LOADER_COMMAND            *Command;
+  UINTN                     CommandNumber;
+  UINTN                     WritePointerSubsetEnd;
   ORIGINAL_ATTRIBUTES       *OriginalPciAttributes;
   UINTN                     OriginalPciAttributesCount;
-  ORDERED_COLLECTION        *AllocationsRestrictedTo32Bit;
-  S3_CONTEXT                *S3Context;
-  ORDERED_COLLECTION        *Tracker;
-  UINTN                     *InstalledKey;
-  INT32                     Installed;
-  ORDERED_COLLECTION_ENTRY  *TrackerEntry, *TrackerEntry2;
-  ORDERED_COLLECTION        *SeenPointers;
-  ORDERED_COLLECTION_ENTRY  *SeenPointerEntry, *SeenPointerEntry2;
+  S3_WRITES                 S3Writes;
+  INSTALLED_TABLES          Installed;
+  SEEN_POINTERS             SeenPointers;
   EFI_HANDLE                QemuAcpiHandle;
+  LOADER_STAT               *Stat;
+  UINT64                    StartTicks;
+  UINT64                    PhaseTicks;
+  UINTN                     VromRegionSize;
+  EFI_PHYSICAL_ADDRESS      VromRegionAddress;
+  UINTN                     SsdtSize;
+  UINT8                     *Ssdt;
+  LOADER_STATS_TABLE        StatsTable;
+
+  PhaseTicks = GetPerformanceCounter ();
+  ZeroMem (mLoaderStats, sizeof mLoaderStats);
+  ZeroMem (mLoaderPhaseTicks, sizeof mLoaderPhaseTicks);
+  mLoaderEntryReads      = 0;
+  mLoaderFwCfgBytes      = 0;
+  mLoaderTablesInstalled = 0;
 
   Status = QemuFwCfgFindFile ("etc/table-loader", &FwCfgItem, &FwCfgSize);
   if (EFI_ERROR (Status)) {
@@ -1164,145 +3453,163 @@ InstallQemuFwCfgTables (
   }
 
   EnablePciDecoding (&OriginalPciAttributes, &OriginalPciAttributesCount);
-  QemuFwCfgSelectItem (FwCfgItem);
-  QemuFwCfgReadBytes (FwCfgSize, LoaderStart);
+  DownloadAndMeasure (FwCfgItem, FwCfgSize, LoaderStart);
   RestorePciDecoding (OriginalPciAttributes, OriginalPciAttributesCount);
+  LoaderPhaseEnd (LoaderPhaseReadScript, &PhaseTicks);
+
+  LoaderEnd = LoaderStart + FwCfgSize / sizeof *LoaderEntry;
+
+  Status = DecodeLoaderScript (LoaderStart, LoaderEnd, &Script);
+  if (!EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_VERBOSE,
+      "%a: loader script/layout hash 0x%016Lx (%Lu blobs)\n",
+      __func__,
+      LoaderLayoutHash (LoaderStart, LoaderEnd, &Script),
+      (UINT64)Script.BlobCount
+      ));
+  }
 
   //
-  // Measure the "etc/table-loader" which is downloaded from QEMU.
-  // It has to be done before it is consumed. Because it would be
-  // updated in the following operations.
+  // The passes below work from the decoded script only, so release the raw
+  // script now rather than keeping it around while the blobs and tables are
+  // being allocated.
   //
-  TpmMeasureAndLogData (
-    1,
-    EV_PLATFORM_CONFIG_FLAGS,
-    EV_POSTCODE_INFO_ACPI_DATA,
-    ACPI_DATA_LEN,
-    (VOID *)(UINTN)LoaderStart,
-    FwCfgSize
-    );
+  FreePool (LoaderStart);
+  if (EFI_ERROR (Status)) {
+    goto ReportStats;
+  }
 
-  LoaderEnd = LoaderStart + FwCfgSize / sizeof *LoaderEntry;
+  LoaderPhaseEnd (LoaderPhaseDecode, &PhaseTicks);
 
-  AllocationsRestrictedTo32Bit = NULL;
-  Status                       = CollectAllocationsRestrictedTo32Bit (
-                                   &AllocationsRestrictedTo32Bit,
-                                   LoaderStart,
-                                   LoaderEnd
-                                   );
+  Status = DownloadBlobs (&Script);
   if (EFI_ERROR (Status)) {
-    goto FreeLoader;
+    goto FreeScript;
   }
 
-  S3Context = NULL;
-  if (QemuFwCfgS3Enabled ()) {
+  LoaderPhaseEnd (LoaderPhaseDownload, &PhaseTicks);
+
+  ZeroMem (&S3Writes, sizeof S3Writes);
+  if (QemuFwCfgS3Enabled () && (Script.CondensedWriteCount > 0)) {
     //
-    // Size the allocation pessimistically, assuming that all commands in the
-    // script are QEMU_LOADER_WRITE_POINTER commands.
+    // The decode pass has counted the writes exactly, after coalescing. If
+    // there are none, there is nothing to replay at S3 resume.
     //
-    Status = AllocateS3Context (&S3Context, LoaderEnd - LoaderStart);
+    Status = AllocateS3Context (&S3Writes.Context, Script.CondensedWriteCount);
     if (EFI_ERROR (Status)) {
-      goto FreeAllocationsRestrictedTo32Bit;
+      goto FreeBlobs;
     }
   }
 
-  Tracker = OrderedCollectionInit (BlobCompare, BlobKeyCompare);
-  if (Tracker == NULL) {
-    Status = EFI_OUT_OF_RESOURCES;
-    goto FreeS3Context;
-  }
-
   //
   // first pass: process the commands
   //
-  // "WritePointerSubsetEnd" points one past the last successful
+  // "WritePointerSubsetEnd" is one past the index of the last successful
   // QEMU_LOADER_WRITE_POINTER command. Now when we're about to start the first
   // pass, no such command has been encountered yet.
   //
-  WritePointerSubsetEnd = LoaderStart;
-  for (LoaderEntry = LoaderStart; LoaderEntry < LoaderEnd; ++LoaderEntry) {
-    switch (LoaderEntry->Type) {
-      case QemuLoaderCmdAllocate:
-        Status = ProcessCmdAllocate (
-                   &LoaderEntry->Command.Allocate,
-                   Tracker,
-                   AllocationsRestrictedTo32Bit
-                   );
-        break;
+  WritePointerSubsetEnd = 0;
+  for (CommandNumber = 0; CommandNumber < Script.CommandCount; ++CommandNumber) {
+    Command    = &Script.Commands[CommandNumber];
+    StartTicks = GetPerformanceCounter ();
 
+    switch (Command->Type) {
       case QemuLoaderCmdAddPointer:
         Status = ProcessCmdAddPointer (
-                   &LoaderEntry->Command.AddPointer,
-                   Tracker
+                   &Command->Command.AddPointer,
+                   Script.Blobs
                    );
         break;
 
       case QemuLoaderCmdAddChecksum:
         Status = ProcessCmdAddChecksum (
-                   &LoaderEntry->Command.AddChecksum,
-                   Tracker
+                   &Command->Command.AddChecksum,
+                   Script.Blobs
                    );
         break;
 
       case QemuLoaderCmdWritePointer:
         Status = ProcessCmdWritePointer (
-                   &LoaderEntry->Command.WritePointer,
-                   Tracker,
-                   S3Context
+                   &Command->Command.WritePointer,
+                   Script.Blobs,
+                   &S3Writes
                    );
         if (!EFI_ERROR (Status)) {
-          WritePointerSubsetEnd = LoaderEntry + 1;
+          WritePointerSubsetEnd = CommandNumber + 1;
         }
 
         break;
 
       default:
-        DEBUG ((
-          DEBUG_VERBOSE,
-          "%a: unknown loader command: 0x%x\n",
-          __func__,
-          LoaderEntry->Type
-          ));
+        ASSERT (FALSE);
+        Status = EFI_PROTOCOL_ERROR;
         break;
     }
 
+    Stat = LoaderStatForCommand (Command->Type);
+    if (Stat != NULL) {
+      Stat->Ticks += GetPerformanceCounter () - StartTicks;
+    }
+
     if (EFI_ERROR (Status)) {
-      goto RollbackWritePointersAndFreeTracker;
+      goto RollbackWritePointers;
     }
   }
 
-  InstalledKey = AllocatePool (INSTALLED_TABLES_MAX * sizeof *InstalledKey);
-  if (InstalledKey == NULL) {
-    Status = EFI_OUT_OF_RESOURCES;
-    goto RollbackWritePointersAndFreeTracker;
+  if (S3Writes.Context != NULL) {
+    Status = S3WritesFlush (&S3Writes);
+    if (EFI_ERROR (Status)) {
+      goto RollbackWritePointers;
+    }
   }
 
-  SeenPointers = OrderedCollectionInit (PointerCompare, PointerCompare);
-  if (SeenPointers == NULL) {
+  LoaderPhaseEnd (LoaderPhaseFirstPass, &PhaseTicks);
+
+  //
+  // One key per AddPointer command, plus one for the VBIOS SSDT and one for
+  // the statistics table.
+  //
+  Installed.Count    = 0;
+  Installed.Capacity = Script.AddPointerCount + 2;
+  Installed.Keys     = AllocatePool (
+                         Installed.Capacity * sizeof *Installed.Keys
+                         );
+  if (Installed.Keys == NULL) {
     Status = EFI_OUT_OF_RESOURCES;
+    goto RollbackWritePointers;
+  }
+
+  Status = SeenPointersInit (&SeenPointers, &Script);
+  if (EFI_ERROR (Status)) {
     goto FreeKeys;
   }
 
   //
   // second pass: identify and install ACPI tables
   //
-  Installed = 0;
-  for (LoaderEntry = LoaderStart; LoaderEntry < LoaderEnd; ++LoaderEntry) {
-    if (LoaderEntry->Type == QemuLoaderCmdAddPointer) {
-      Status = Process2ndPassCmdAddPointer (
-                 &LoaderEntry->Command.AddPointer,
-                 Tracker,
-                 AcpiProtocol,
-                 InstalledKey,
-                 &Installed,
-                 SeenPointers
-                 );
-      if (EFI_ERROR (Status)) {
-        goto UninstallAcpiTables;
-      }
+  StartTicks = GetPerformanceCounter ();
+  for (CommandNumber = 0;
+       CommandNumber < Script.AddPointerCount;
+       ++CommandNumber)
+  {
+    Command = &Script.Commands[Script.AddPointers[CommandNumber]];
+    mLoaderStats[LoaderStatInstallTables].Count++;
+    Status = Process2ndPassCmdAddPointer (
+               &Command->Command.AddPointer,
+               &Script,
+               AcpiProtocol,
+               &Installed,
+               &SeenPointers
+               );
+    if (EFI_ERROR (Status)) {
+      goto UninstallAcpiTables;
     }
   }
 
+  mLoaderStats[LoaderStatInstallTables].Ticks +=
+    GetPerformanceCounter () - StartTicks;
+  LoaderPhaseEnd (LoaderPhaseSecondPass, &PhaseTicks);
+
   //
   // Install a protocol to notify that the ACPI table provided by Qemu is
   // ready.
@@ -1318,95 +3625,105 @@ InstallQemuFwCfgTables (
     goto UninstallAcpiTables;
   }
 
-   // modification: add additional SSDT
-   UINT32 VromSize = 256*1024;
-   UINT8* FwData = AllocateRuntimePool(VromSize); // 256*1024 = 256 KB = size of VROM image
-
-   // copy VROM to FwData
-   CopyMem (FwData, VROM_BIN, VROM_BIN_LEN);
-
-   // header of SSDT table: DefinitionBlock ("Ssdt.aml", "SSDT", 1, "REDHAT", "OVMF    ", 1)
-   unsigned char Ssdt_header[] = {
-   0x53, 0x53, 0x44, 0x54, 0x24, 0x00, 0x00, 0x00, 0x01, 0x86, 0x52, 0x45,
-   0x44, 0x48, 0x41, 0x54, 0x4f, 0x56, 0x4d, 0x46, 0x20, 0x20, 0x20, 0x20,
-   0x01, 0x00, 0x00, 0x00, 0x49, 0x4e, 0x54, 0x4c, 0x31, 0x08, 0x16, 0x20
-   };
-
-   // byte 4-7: length header + table in little endian (so equal to SsdtSize)
-   // byte 8: version complicance number: nothing needs to change
-   // byte 9: set such that when all bytes are added modulo 256 the sum equals 0
-   // calculate checksum: already implemented as CalculateCheckSum8(offset, length)
-
-   unsigned int Ssdt_header_len = 36;
-
-   UINTN                SsdtSize;
-   UINT8                *Ssdt;
-
-   SsdtSize = Ssdt_header_len + 17 + vrom_table_len;
-   Ssdt = AllocatePool (SsdtSize);
-
-   UINT8 *SsdtPtr = Ssdt;
-
-   // copy header to Ssdt table
-   CopyMem (SsdtPtr, Ssdt_header, Ssdt_header_len);
-   SsdtPtr += Ssdt_header_len;
-
-   // build "OperationRegion(FWDT, SystemMemory, 0x12345678, 0x87654321)"
-   //
-   *(SsdtPtr++) = 0x5B; // ExtOpPrefix
-   *(SsdtPtr++) = 0x80; // OpRegionOp
-   *(SsdtPtr++) = 'V';
-   *(SsdtPtr++) = 'B';
-   *(SsdtPtr++) = 'O';
-   *(SsdtPtr++) = 'R';
-   *(SsdtPtr++) = 0x00; // SystemMemory
-   *(SsdtPtr++) = 0x0C; // DWordPrefix
-
-   //
-   // no virtual addressing yet, take the four least significant bytes
-   //
-   CopyMem(SsdtPtr, &FwData, 4);
-   SsdtPtr += 4;
+  //
+  // Expose the VBIOS image to the guest OS, in an additional SSDT.
+  //
+  Status = PrepareVromSsdt (
+             &VromRegionAddress,
+             &VromRegionSize,
+             &Ssdt,
+             &SsdtSize
+             );
+  if (EFI_ERROR (Status)) {
+    goto UninstallQemuAcpiTableNotifyProtocol;
+  }
 
-   *(SsdtPtr++) = 0x0C; // DWordPrefix
+  LoaderPhaseEnd (LoaderPhaseVbiosSsdt, &PhaseTicks);
+
+  StartTicks = GetPerformanceCounter ();
+  if (Ssdt != NULL) {
+    ASSERT (Installed.Count < Installed.Capacity);
+    Status = AcpiProtocol->InstallAcpiTable (
+                             AcpiProtocol,
+                             Ssdt,
+                             SsdtSize,
+                             &Installed.Keys[Installed.Count]
+                             );
+    FreePool (Ssdt);
+    if (EFI_ERROR (Status)) {
+      goto FreeVromRegion;
+    }
 
-   *(UINT32*) SsdtPtr = VromSize;
-   SsdtPtr += 4;
+    ++Installed.Count;
+  }
 
-   CopyMem (SsdtPtr, vrom_table, vrom_table_len);
+  StatsTable.RecordAddress = 0;
+  if (LOADER_STATS_PUBLISH) {
+    Status = PrepareLoaderStatsTable (&StatsTable);
+    if (EFI_ERROR (Status)) {
+      goto FreeVromRegion;
+    }
 
-   // set the correct size in the header
-   UINT32* size_ptr = (UINT32*) &Ssdt[4];
-   *size_ptr = SsdtSize;
+    ASSERT (Installed.Count < Installed.Capacity);
+    Status = AcpiProtocol->InstallAcpiTable (
+                             AcpiProtocol,
+                             &StatsTable,
+                             sizeof StatsTable,
+                             &Installed.Keys[Installed.Count]
+                             );
+    if (EFI_ERROR (Status)) {
+      goto FreeStatsRecord;
+    }
 
-   // set byte 9 of header so the checksum equals 0
-   Ssdt[9] = 0;
-   UINT32 checksum = CalculateCheckSum8(Ssdt, SsdtSize);
-   Ssdt[9] = (256 - checksum) % 256;
+    ++Installed.Count;
+  }
 
-   Status = AcpiProtocol->InstallAcpiTable (AcpiProtocol,
-                            (VOID *) Ssdt, SsdtSize,
-                            &InstalledKey[Installed]);
-   ++Installed;
+  mLoaderStats[LoaderStatInstallTables].Ticks +=
+    GetPerformanceCounter () - StartTicks;
+  LoaderPhaseEnd (LoaderPhaseInstallTables, &PhaseTicks);
 
   //
   // Translating the condensed QEMU_LOADER_WRITE_POINTER commands to ACPI S3
   // Boot Script opcodes has to be the last operation in this function, because
   // if it succeeds, it cannot be undone.
   //
-  if (S3Context != NULL) {
-    Status = TransferS3ContextToBootScript (S3Context);
+  if (S3Writes.Context != NULL) {
+    Status = TransferS3ContextToBootScript (S3Writes.Context);
     if (EFI_ERROR (Status)) {
-      goto UninstallQemuAcpiTableNotifyProtocol;
+      goto FreeStatsRecord;
     }
 
     //
-    // Ownership of S3Context has been transferred.
+    // Ownership of S3Writes.Context has been transferred.
     //
-    S3Context = NULL;
+    S3Writes.Context = NULL;
+    LoaderPhaseEnd (LoaderPhaseS3Transfer, &PhaseTicks);
+  }
+
+  mLoaderTablesInstalled = Installed.Count;
+  if (StatsTable.RecordAddress != 0) {
+    PublishLoaderStats (StatsTable.RecordAddress);
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: installed %Lu tables\n",
+    __func__,
+    (UINT64)Installed.Count
+    ));
+
+FreeStatsRecord:
+  if (EFI_ERROR (Status) && (StatsTable.RecordAddress != 0)) {
+    gBS->FreePages (
+           StatsTable.RecordAddress,
+           EFI_SIZE_TO_PAGES (sizeof (LOADER_STATS_RECORD))
+           );
   }
 
-  DEBUG ((DEBUG_INFO, "%a: installed %d tables\n", __func__, Installed));
+FreeVromRegion:
+  if (EFI_ERROR (Status) && (VromRegionSize > 0)) {
+    gBS->FreePages (VromRegionAddress, EFI_SIZE_TO_PAGES (VromRegionSize));
+  }
 
 UninstallQemuAcpiTableNotifyProtocol:
   if (EFI_ERROR (Status)) {
@@ -1422,80 +3739,51 @@ UninstallAcpiTables:
     //
     // roll back partial installation
     //
-    while (Installed > 0) {
-      --Installed;
-      AcpiProtocol->UninstallAcpiTable (AcpiProtocol, InstalledKey[Installed]);
+    while (Installed.Count > 0) {
+      --Installed.Count;
+      AcpiProtocol->UninstallAcpiTable (
+                      AcpiProtocol,
+                      Installed.Keys[Installed.Count]
+                      );
     }
   }
 
-  for (SeenPointerEntry = OrderedCollectionMin (SeenPointers);
-       SeenPointerEntry != NULL;
-       SeenPointerEntry = SeenPointerEntry2)
-  {
-    SeenPointerEntry2 = OrderedCollectionNext (SeenPointerEntry);
-    OrderedCollectionDelete (SeenPointers, SeenPointerEntry, NULL);
-  }
-
-  OrderedCollectionUninit (SeenPointers);
+  SeenPointersUninit (&SeenPointers);
 
 FreeKeys:
-  FreePool (InstalledKey);
+  FreePool (Installed.Keys);
 
-RollbackWritePointersAndFreeTracker:
+RollbackWritePointers:
   //
   // In case of failure, revoke any allocation addresses that were communicated
   // to QEMU previously, before we release all the blobs.
   //
   if (EFI_ERROR (Status)) {
-    LoaderEntry = WritePointerSubsetEnd;
-    while (LoaderEntry > LoaderStart) {
-      --LoaderEntry;
-      if (LoaderEntry->Type == QemuLoaderCmdWritePointer) {
-        UndoCmdWritePointer (&LoaderEntry->Command.WritePointer);
+    CommandNumber = WritePointerSubsetEnd;
+    while (CommandNumber > 0) {
+      --CommandNumber;
+      Command = &Script.Commands[CommandNumber];
+      if (Command->Type == QemuLoaderCmdWritePointer) {
+        UndoCmdWritePointer (&Command->Command.WritePointer);
       }
     }
   }
 
-  //
-  // Tear down the tracker infrastructure. Each fw_cfg blob will be left in
-  // place only if we're exiting with success and the blob hosts data that is
-  // not directly part of some ACPI table.
-  //
-  for (TrackerEntry = OrderedCollectionMin (Tracker); TrackerEntry != NULL;
-       TrackerEntry = TrackerEntry2)
-  {
-    VOID  *UserStruct;
-    BLOB  *Blob;
-
-    TrackerEntry2 = OrderedCollectionNext (TrackerEntry);
-    OrderedCollectionDelete (Tracker, TrackerEntry, &UserStruct);
-    Blob = UserStruct;
-
-    if (EFI_ERROR (Status) || Blob->HostsOnlyTableData) {
-      DEBUG ((
-        DEBUG_VERBOSE,
-        "%a: freeing \"%a\"\n",
-        __func__,
-        Blob->File
-        ));
-      gBS->FreePages ((UINTN)Blob->Base, EFI_SIZE_TO_PAGES (Blob->Size));
-    }
-
-    FreePool (Blob);
-  }
-
-  OrderedCollectionUninit (Tracker);
-
-FreeS3Context:
-  if (S3Context != NULL) {
-    ReleaseS3Context (S3Context);
+  if (S3Writes.Context != NULL) {
+    ReleaseS3Context (S3Writes.Context);
   }
 
-FreeAllocationsRestrictedTo32Bit:
-  ReleaseAllocationsRestrictedTo32Bit (AllocationsRestrictedTo32Bit);
+FreeBlobs:
+  //
+  // Each fw_cfg blob will be left in place only if we're exiting with success
+  // and the blob hosts data that is not directly part of some ACPI table.
+  //
+  ReleaseBlobs (&Script, EFI_ERROR (Status));
 
-FreeLoader:
-  FreePool (LoaderStart);
+FreeScript:
+  ReleaseLoaderScript (&Script);
 
+ReportStats:
+  ReportLoaderStats ();
   return Status;
 }
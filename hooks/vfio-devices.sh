@@ -0,0 +1,127 @@
+#!/bin/bash
+
+#############################################################################
+## Per-device rebinding shared by vfio-startup.sh and vfio-teardown.sh     ##
+##                                                                         ##
+## Moves only the PCI functions listed as <hostdev> in a domain XML to     ##
+## vfio-pci through driver_override, and gives them back to their old      ##
+## drivers on release. The host display and any other GPU stay up.         ##
+##                                                                         ##
+## Source this file (after vfio-modules.sh), then call:                    ##
+##     vfio_domain_hostdevs <domain.xml>                                   ##
+##     vfio_devices_bind <address>...                                      ##
+##     vfio_devices_release                                                ##
+#############################################################################
+
+################################# Variables #################################
+
+## Roots, overridable to run against a fake sysfs tree ##
+SYSFS_PCI_ROOT="${SYSFS_PCI_ROOT:-/sys/bus/pci}"
+
+## Devices moved to vfio-pci, one "address driver" line each ##
+VFIO_DEVICE_STATE="${VFIO_DEVICE_STATE:-/tmp/vfio-rebound-devices}"
+
+################################# Functions #################################
+
+## Prints the host address (dddd:bb:ss.f) of every PCI hostdev in a domain XML ##
+function vfio_domain_hostdevs {
+    awk -v q="'" '
+        function attr(name,   v) {
+            if (!match($0, name "=[\"" q "][^\"" q "]*"))
+                return ""
+            v = substr($0, RSTART + length(name) + 2, RLENGTH - length(name) - 2)
+            sub(/^0[xX]/, "", v)
+            return tolower(v)
+        }
+        function pad(v, n) {
+            while (length(v) < n)
+                v = "0" v
+            return v
+        }
+        ## One record per tag, however the XML is laid out ##
+        BEGIN { RS = ">" }
+        /<hostdev/ { in_hostdev = ($0 ~ ("type=[\"" q "]pci[\"" q "]")) }
+        in_hostdev && /<source/ { in_source = 1 }
+        in_source && /<address/ {
+            print pad(attr("domain"), 4) ":" pad(attr("bus"), 2) ":" \
+                  pad(attr("slot"), 2) "." attr("function")
+        }
+        /<\/source/ { in_source = 0 }
+        /<\/hostdev/ { in_hostdev = 0; in_source = 0 }' "$1"
+}
+
+## Name of the driver bound to a device, empty if none ##
+function device_driver {
+    if test -e "$SYSFS_PCI_ROOT/devices/$1/driver"; then
+        basename "$(readlink "$SYSFS_PCI_ROOT/devices/$1/driver")"
+    fi
+}
+
+function vfio_devices_bind {
+    local addr dev driver start
+
+    for addr in "$@"; do
+        dev="$SYSFS_PCI_ROOT/devices/$addr"
+        if ! test -e "$dev"; then
+            echo "$DATE Device $addr not found, skipping"
+            continue
+        fi
+
+        driver=$(device_driver "$addr")
+        if [[ $driver == "vfio-pci" ]]; then
+            echo "$DATE Device $addr is already bound to vfio-pci"
+            continue
+        fi
+
+        start=$(now_us)
+        echo "$addr ${driver:--}" >>"$VFIO_DEVICE_STATE"
+        echo "vfio-pci" >"$dev/driver_override"
+        if [[ -n $driver ]]; then
+            echo "$addr" >"$dev/driver/unbind"
+        fi
+        echo "$addr" >"$SYSFS_PCI_ROOT/drivers_probe"
+
+        if [[ $(device_driver "$addr") == "vfio-pci" ]]; then
+            echo "$DATE Device $addr moved from ${driver:-no driver} to vfio-pci in $(( ($(now_us) - start) / 1000 )) ms"
+        else
+            echo "$DATE Device $addr did not bind to vfio-pci"
+        fi
+    done
+}
+
+function vfio_devices_release {
+    local addr driver dev now start
+
+    if ! test -e "$VFIO_DEVICE_STATE"; then
+        return 0
+    fi
+
+    while read -r addr driver; do
+        dev="$SYSFS_PCI_ROOT/devices/$addr"
+        if ! test -e "$dev"; then
+            echo "$DATE Device $addr not found, skipping"
+            continue
+        fi
+
+        start=$(now_us)
+        echo >"$dev/driver_override"
+
+        ## libvirt may already have given the device back (managed="yes") ##
+        now=$(device_driver "$addr")
+        if [[ $now != "vfio-pci" ]]; then
+            echo "$DATE Device $addr is already on ${now:-no driver}, leaving it"
+            continue
+        fi
+        echo "$addr" >"$dev/driver/unbind"
+
+        ## With the override cleared, probing picks the device's own driver ##
+        if [[ $driver != "-" ]]; then
+            echo "$addr" >"$SYSFS_PCI_ROOT/drivers_probe"
+        fi
+
+        now=$(device_driver "$addr")
+        echo "$DATE Device $addr returned to ${now:-no driver} in $(( ($(now_us) - start) / 1000 )) ms"
+    done <"$VFIO_DEVICE_STATE"
+
+    rm -f "$VFIO_DEVICE_STATE"
+}
@@ -0,0 +1,247 @@
+#!/bin/bash
+
+#############################################################################
+## Module engine shared by vfio-startup.sh and vfio-teardown.sh            ##
+##                                                                         ##
+## Loads or unloads a set of kernel modules, ordered by modules.dep and,   ##
+## where that leaves a choice, by the order given. Unloads run one at a    ##
+## time. Loads run in parallel only for modules that share no dependency,  ##
+## so competing drivers such as amdgpu and radeon keep the order given.    ##
+## Modules that are already in the wanted state are skipped, and the time  ##
+## taken by each modprobe is logged.                                       ##
+##                                                                         ##
+## Source this file, then call:                                            ##
+##     vfio_modules_unload <module>...                                     ##
+##     vfio_modules_load <module>...                                       ##
+#############################################################################
+
+################################# Variables #################################
+
+## Roots, overridable to run against a fake tree and a stub modprobe ##
+SYSFS_MODULE_ROOT="${SYSFS_MODULE_ROOT:-/sys/module}"
+MODULES_DEP="${MODULES_DEP:-/lib/modules/$(uname -r)/modules.dep}"
+MODULES_BUILTIN="${MODULES_BUILTIN:-/lib/modules/$(uname -r)/modules.builtin}"
+MODPROBE="${MODPROBE:-modprobe}"
+
+DATE="${DATE:-$(date +"%m/%d/%Y %R:%S :")}"
+
+################################# Functions #################################
+
+## Current time in microseconds, for the timing log ##
+function now_us {
+    if [[ -n "$EPOCHREALTIME" ]]; then
+        echo "${EPOCHREALTIME/[.,]/}"
+    else
+        date +%s%6N
+    fi
+}
+
+## Built-in modules are listed in modules.builtin and can't be unloaded ##
+function module_is_builtin {
+    test -r "$MODULES_BUILTIN" && awk -v mod="$1" '
+        {
+            sub(/.*\//, "")
+            sub(/\.ko$/, "")
+            gsub(/-/, "_")
+            if ($0 == mod) {
+                found = 1
+                exit
+            }
+        }
+        END { exit !found }' "$MODULES_BUILTIN"
+}
+
+## Loadable modules show up in sysfs; built-in ones only if they have ##
+## parameters, so modules.builtin is checked as well                  ##
+function module_is_loaded {
+    test -e "$SYSFS_MODULE_ROOT/$1" || module_is_builtin "$1"
+}
+
+## True when the module is not yet in the state asked for by $1 ##
+function module_needs_work {
+    if [[ $1 == "unload" ]]; then
+        module_is_loaded "$2" && ! module_is_builtin "$2"
+    else
+        ! module_is_loaded "$2"
+    fi
+}
+
+## Prints "module dep dep ..." for each module in the set, with all of its ##
+## dependencies. modules.dep is already transitive.                        ##
+function module_deps {
+    awk -v set=" $* " '
+        function name(path) {
+            sub(/:$/, "", path)
+            sub(/.*\//, "", path)
+            sub(/\.ko(\.[a-z]+)?$/, "", path)
+            gsub(/-/, "_", path)
+            return path
+        }
+        {
+            mod = name($1)
+            if (index(set, " " mod " ") == 0)
+                next
+            line = mod
+            for (i = 2; i <= NF; i++)
+                line = line " " name($i)
+            print line
+        }' "$MODULES_DEP"
+}
+
+## True when two dependency lists (" a b ") have a module in common ##
+function deps_overlap {
+    local dep
+
+    for dep in $1; do
+        if [[ $2 == *" $dep "* ]]; then
+            return 0
+        fi
+    done
+    return 1
+}
+
+## Loads or unloads one module and logs how long it took ##
+function module_run_one {
+    local mode="$1" mod="$2" refcnt start rc
+
+    if [[ $mode == "unload" ]]; then
+        ## Users inside the set are gone by now, so refcnt counts outside users ##
+        read -r refcnt 2>/dev/null <"$SYSFS_MODULE_ROOT/$mod/refcnt"
+        if [[ ${refcnt:-0} != 0 ]]; then
+            echo "$DATE Module $mod is in use (refcnt $refcnt), leaving it loaded"
+            return 1
+        fi
+        start=$(now_us)
+        "$MODPROBE" -r "$mod"
+    else
+        start=$(now_us)
+        "$MODPROBE" "$mod"
+    fi
+    rc=$?
+
+    if [ "$rc" = 0 ]; then
+        echo "$DATE Module $mod ${mode}ed in $(( ($(now_us) - start) / 1000 )) ms"
+    else
+        echo "$DATE Module $mod failed to $mode (status $rc) after $(( ($(now_us) - start) / 1000 )) ms"
+    fi
+    return "$rc"
+}
+
+## Runs modprobe over a set of modules in dependency order.  ##
+## $1 is "load" or "unload", the rest are module names.      ##
+## Each round runs the modules that are free to go, in       ##
+## parallel for loads, and one at a time for unloads.        ##
+function vfio_modules_run {
+    local mode="$1"
+    shift
+
+    local -A deps=()
+    local -a pending=() wave=() rest=()
+    local mod other serial=0 blocked
+    local earlier
+
+    for mod in "$@"; do
+        mod="${mod//-/_}"
+        if module_needs_work "$mode" "$mod"; then
+            pending+=("$mod")
+        elif module_is_builtin "$mod"; then
+            echo "$DATE Module $mod is built in, skipping"
+        elif [[ $mode == "unload" ]]; then
+            echo "$DATE Module $mod is not loaded, skipping"
+        else
+            echo "$DATE Module $mod is already loaded, skipping"
+        fi
+    done
+
+    if (( ${#pending[@]} == 0 )); then
+        return 0
+    fi
+
+    if [[ -r $MODULES_DEP ]]; then
+        while read -r mod other; do
+            deps[$mod]=" $other "
+        done < <(module_deps "${pending[@]}")
+    else
+        echo "$DATE $MODULES_DEP not found, running modules one at a time"
+        serial=1
+    fi
+
+    while (( ${#pending[@]} )); do
+        wave=()
+        earlier=""
+        for mod in "${pending[@]}"; do
+            if (( serial )); then
+                wave=("$mod")
+                break
+            fi
+
+            ## Unload after everything that depends on it, load after its deps ##
+            blocked=0
+            for other in "${pending[@]}"; do
+                if [[ $mode == "unload" && ${deps[$other]} == *" $mod "* ]] ||
+                   [[ $mode == "load" && ${deps[$mod]} == *" $other "* ]]; then
+                    blocked=1
+                    break
+                fi
+            done
+
+            ## Modules sharing a dependency may compete for the same devices, ##
+            ## so a load waits for every such module listed before it, unless ##
+            ## that module needs this one first                               ##
+            if (( ! blocked )) && [[ $mode == "load" ]]; then
+                for other in $earlier; do
+                    if [[ ${deps[$other]} != *" $mod "* ]] &&
+                       deps_overlap "${deps[$mod]}" "${deps[$other]}"; then
+                        blocked=1
+                        break
+                    fi
+                done
+            fi
+            earlier="$earlier $mod"
+
+            if (( ! blocked )); then
+                wave+=("$mod")
+                if [[ $mode == "unload" ]]; then
+                    break
+                fi
+            fi
+        done
+
+        if (( ${#wave[@]} == 0 )); then
+            wave=("${pending[0]}")
+        fi
+
+        if (( ${#wave[@]} == 1 )); then
+            module_run_one "$mode" "${wave[0]}"
+        else
+            for mod in "${wave[@]}"; do
+                module_run_one "$mode" "$mod" &
+            done
+            wait
+        fi
+
+        ## modprobe may already have handled later modules as dependencies ##
+        rest=()
+        for mod in "${pending[@]}"; do
+            if [[ " ${wave[*]} " != *" $mod "* ]] && module_needs_work "$mode" "$mod"; then
+                rest+=("$mod")
+            fi
+        done
+        pending=("${rest[@]}")
+    done
+
+    for mod in "$@"; do
+        if module_needs_work "$mode" "${mod//-/_}"; then
+            return 1
+        fi
+    done
+    return 0
+}
+
+function vfio_modules_unload {
+    vfio_modules_run unload "$@"
+}
+
+function vfio_modules_load {
+    vfio_modules_run load "$@"
+}
@@ -28,28 +28,81 @@ DATE=$(date +"%m/%d/%Y %R:%S :")
 ## Sets dispmgr var as null ##
 DISPMGR="null"
 
+## Seconds to wait for a display manager stop or target switch to finish ##
+DM_STOP_TIMEOUT="${DM_STOP_TIMEOUT:-30}"
+
+## Root of the files the script touches, overridable to dry-run it ##
+## against a fake tree                                             ##
+HOOK_ROOT="${HOOK_ROOT:-}"
+
+## Module engine and per-device rebinding, installed next to this script ##
+source "$(dirname "$(readlink -f "$0")")/vfio-modules.sh"
+source "$(dirname "$(readlink -f "$0")")/vfio-devices.sh"
+
+## Stage timing log ##
+SCRIPT_START=$(now_us)
+
+function stage_begin {
+    STAGE_NAME="$1"
+    STAGE_START=$(now_us)
+}
+
+function stage_end {
+    echo "$DATE Stage $STAGE_NAME took $(( ($(now_us) - STAGE_START) / 1000 )) ms"
+}
+
+## Runs a systemctl job and waits for it to finish, but no longer than ##
+## DM_STOP_TIMEOUT. systemctl itself blocks until the job completes.   ##
+## Returns its status, 124 on a timeout.                               ##
+function systemctl_wait {
+    timeout "$DM_STOP_TIMEOUT" systemctl "$@"
+    local rc=$?
+
+    if [ "$rc" = 124 ]; then
+        echo "$DATE Timed out after ${DM_STOP_TIMEOUT}s waiting for systemctl $*"
+    elif [ "$rc" != 0 ]; then
+        echo "$DATE systemctl $* failed with status $rc"
+    fi
+    return "$rc"
+}
+
 ################################## Script ###################################
 
 echo "$DATE Beginning of Startup!"
 
+##############################################################################
+## Per-device mode: vfio-startup.sh --devices <domain.xml>                  ##
+## Only the domain's <hostdev> functions move to vfio-pci; the host drivers ##
+## and display manager are left alone.                                      ##
+##############################################################################
+if [[ $1 == "--devices" ]]; then
+    stage_begin "vfio-modules"
+    vfio_modules_load vfio vfio_pci vfio_iommu_type1
+    stage_end
+
+    stage_begin "rebind-devices"
+    vfio_devices_bind $(vfio_domain_hostdevs "$2")
+    stage_end
+
+    echo "$DATE Startup took $(( ($(now_us) - SCRIPT_START) / 1000 )) ms"
+    echo "$DATE End of Startup!"
+    exit 0
+fi
+
 
 function stop_display_manager_if_running {
     ## Get display manager on systemd based distros ##
-    if [[ -x /run/systemd/system ]] && echo "$DATE Distro is using Systemd"; then
-        DISPMGR="$(grep 'ExecStart=' /etc/systemd/system/display-manager.service | awk -F'/' '{print $(NF-0)}')"
+    if [[ -x "$HOOK_ROOT/run/systemd/system" ]] && echo "$DATE Distro is using Systemd"; then
+        DISPMGR="$(grep 'ExecStart=' "$HOOK_ROOT/etc/systemd/system/display-manager.service" | awk -F'/' '{print $(NF-0)}')"
         echo "$DATE Display Manager = $DISPMGR"
 
         ## Stop display manager using systemd ##
         if systemctl is-active --quiet "$DISPMGR.service"; then
-            grep -qsF "$DISPMGR" "/tmp/vfio-store-display-manager" || echo "$DISPMGR" >/tmp/vfio-store-display-manager
-            systemctl stop "$DISPMGR.service"
-            systemctl isolate multi-user.target
+            grep -qsF "$DISPMGR" "$HOOK_ROOT/tmp/vfio-store-display-manager" || echo "$DISPMGR" >"$HOOK_ROOT/tmp/vfio-store-display-manager"
+            systemctl_wait stop "$DISPMGR.service" || return
+            systemctl_wait isolate multi-user.target || return
         fi
 
-        while systemctl is-active --quiet "$DISPMGR.service"; do
-            sleep "1"
-        done
-
         return
 
     fi
@@ -63,14 +116,10 @@ function kde-clause {
     ## Stop display manager using systemd ##
     if systemctl is-active --quiet "display-manager.service"; then
     
-        grep -qsF "display-manager" "/tmp/vfio-store-display-manager"  || echo "display-manager" >/tmp/vfio-store-display-manager
-        systemctl stop "display-manager.service"
+        grep -qsF "display-manager" "$HOOK_ROOT/tmp/vfio-store-display-manager"  || echo "display-manager" >"$HOOK_ROOT/tmp/vfio-store-display-manager"
+        systemctl_wait stop "display-manager.service" || return
     fi
 
-        while systemctl is-active --quiet "display-manager.service"; do
-                sleep 2
-        done
-
     return
 
 }
@@ -80,6 +129,7 @@ function kde-clause {
 ## Have to specify the display manager because kde is weird and uses display-manager even though it returns sddm. ##
 ####################################################################################################################
 
+stage_begin "display-manager"
 if pgrep -l "plasma" | grep "plasmashell"; then
     echo "$DATE Display Manager is KDE, running KDE clause!"
     kde-clause
@@ -87,70 +137,70 @@ if pgrep -l "plasma" | grep "plasmashell"; then
         echo "$DATE Display Manager is not KDE!"
         stop_display_manager_if_running
 fi
+DM_STATUS=$?
+stage_end
+
+## The GPU drivers cannot be unloaded while the display manager holds them ##
+if [ "$DM_STATUS" != 0 ]; then
+    echo "$DATE Display manager did not stop, aborting startup"
+    exit 1
+fi
 
 ## Unbind EFI-Framebuffer ##
-if test -e "/tmp/vfio-is-nvidia"; then
-    rm -f /tmp/vfio-is-nvidia
+if test -e "$HOOK_ROOT/tmp/vfio-is-nvidia"; then
+    rm -f "$HOOK_ROOT/tmp/vfio-is-nvidia"
     else
-        test -e "/tmp/vfio-is-amd"
-        rm -f /tmp/vfio-is-amd
+        test -e "$HOOK_ROOT/tmp/vfio-is-amd"
+        rm -f "$HOOK_ROOT/tmp/vfio-is-amd"
 fi
 
-sleep "1"
-
 ##############################################################################################################################
 ## Unbind VTconsoles if currently bound (adapted and modernised from https://www.kernel.org/doc/Documentation/fb/fbcon.txt) ##
 ##############################################################################################################################
-if test -e "/tmp/vfio-bound-consoles"; then
-    rm -f /tmp/vfio-bound-consoles
+stage_begin "vtconsoles"
+if test -e "$HOOK_ROOT/tmp/vfio-bound-consoles"; then
+    rm -f "$HOOK_ROOT/tmp/vfio-bound-consoles"
 fi
 for (( i = 0; i < 16; i++))
 do
-  if test -x /sys/class/vtconsole/vtcon"${i}"; then
-      if [ "$(grep -c "frame buffer" /sys/class/vtconsole/vtcon"${i}"/name)" = 1 ]; then
-	       echo 0 > /sys/class/vtconsole/vtcon"${i}"/bind
+  if test -x "$HOOK_ROOT"/sys/class/vtconsole/vtcon"${i}"; then
+      if [ "$(grep -c "frame buffer" "$HOOK_ROOT"/sys/class/vtconsole/vtcon"${i}"/name)" = 1 ]; then
+	       echo 0 > "$HOOK_ROOT"/sys/class/vtconsole/vtcon"${i}"/bind
            echo "$DATE Unbinding Console ${i}"
-           echo "$i" >> /tmp/vfio-bound-consoles
+           echo "$i" >> "$HOOK_ROOT/tmp/vfio-bound-consoles"
       fi
   fi
 done
+stage_end
 
-sleep "1"
-
+stage_begin "gpu-drivers"
 if lspci -nn | grep -e VGA | grep -s NVIDIA ; then
     echo "$DATE System has an NVIDIA GPU"
-    grep -qsF "true" "/tmp/vfio-is-nvidia" || echo "true" >/tmp/vfio-is-nvidia
-    echo efi-framebuffer.0 > /sys/bus/platform/drivers/efi-framebuffer/unbind
+    grep -qsF "true" "$HOOK_ROOT/tmp/vfio-is-nvidia" || echo "true" >"$HOOK_ROOT/tmp/vfio-is-nvidia"
+    echo efi-framebuffer.0 > "$HOOK_ROOT/sys/bus/platform/drivers/efi-framebuffer/unbind"
 
     ## Unload NVIDIA GPU drivers ##
-    modprobe -r nvidia_uvm
-    modprobe -r nvidia_drm
-    modprobe -r nvidia_modeset
-    modprobe -r nvidia
-    modprobe -r i2c_nvidia_gpu
-    modprobe -r drm_kms_helper
-    modprobe -r drm
+    vfio_modules_unload nvidia_uvm nvidia_drm nvidia_modeset nvidia i2c_nvidia_gpu drm_kms_helper drm
 
     echo "$DATE NVIDIA GPU Drivers Unloaded"
 fi
 
 if lspci -nn | grep -e VGA | grep -s AMD ; then
     echo "$DATE System has an AMD GPU"
-    grep -qsF "true" "/tmp/vfio-is-amd" || echo "true" >/tmp/vfio-is-amd
-    echo efi-framebuffer.0 > /sys/bus/platform/drivers/efi-framebuffer/unbind
+    grep -qsF "true" "$HOOK_ROOT/tmp/vfio-is-amd" || echo "true" >"$HOOK_ROOT/tmp/vfio-is-amd"
+    echo efi-framebuffer.0 > "$HOOK_ROOT/sys/bus/platform/drivers/efi-framebuffer/unbind"
 
     ## Unload AMD GPU drivers ##
-    modprobe -r drm_kms_helper
-    modprobe -r amdgpu
-    modprobe -r radeon
-    modprobe -r drm
+    vfio_modules_unload drm_kms_helper amdgpu radeon drm
 
     echo "$DATE AMD GPU Drivers Unloaded"
 fi
+stage_end
 
 ## Load VFIO-PCI driver ##
-modprobe vfio
-modprobe vfio_pci
-modprobe vfio_iommu_type1
+stage_begin "vfio-modules"
+vfio_modules_load vfio vfio_pci vfio_iommu_type1
+stage_end
 
+echo "$DATE Startup took $(( ($(now_us) - SCRIPT_START) / 1000 )) ms"
 echo "$DATE End of Startup!"
@@ -25,27 +25,30 @@
 ## Adds current time to var for use in echo for a cleaner log and script ##
 DATE=$(date +"%m/%d/%Y %R:%S :")
 
+## Module engine and per-device rebinding, installed next to this script ##
+source "$(dirname "$(readlink -f "$0")")/vfio-modules.sh"
+source "$(dirname "$(readlink -f "$0")")/vfio-devices.sh"
+
 ################################## Script ###################################
 
 echo "$DATE Beginning of Teardown!"
 
+## Per-device mode: hand the rebound functions back to their drivers ##
+if [[ $1 == "--devices" ]]; then
+    vfio_devices_release
+    echo "$DATE End of Teardown!"
+    exit 0
+fi
+
 ## Unload VFIO-PCI driver ##
-modprobe -r vfio_pci
-modprobe -r vfio_iommu_type1
-modprobe -r vfio
+vfio_modules_unload vfio_pci vfio_iommu_type1 vfio
 
 if grep -q "true" "/tmp/vfio-is-nvidia" ; then
 
     ## Load NVIDIA drivers ##
     echo "$DATE Loading NVIDIA GPU Drivers"
-    
-    modprobe drm
-    modprobe drm_kms_helper
-    modprobe i2c_nvidia_gpu
-    modprobe nvidia
-    modprobe nvidia_modeset
-    modprobe nvidia_drm
-    modprobe nvidia_uvm
+
+    vfio_modules_load drm drm_kms_helper i2c_nvidia_gpu nvidia nvidia_modeset nvidia_drm nvidia_uvm
 
     echo "$DATE NVIDIA GPU Drivers Loaded"
 fi
@@ -54,12 +57,9 @@ if  grep -q "true" "/tmp/vfio-is-amd" ; then
 
     ## Load NVIDIA drivers ##
     echo "$DATE Loading AMD GPU Drivers"
-    
-    modprobe drm
-    modprobe amdgpu
-    modprobe radeon
-    modprobe drm_kms_helper
-    
+
+    vfio_modules_load drm amdgpu radeon drm_kms_helper
+
     echo "$DATE AMD GPU Drivers Loaded"
 fi
 
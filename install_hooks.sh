@@ -16,6 +16,14 @@ if test -e /bin/vfio-teardown.sh;
 then
     mv /bin/vfio-teardown.sh /bin/vfio-teardown.sh.bkp
 fi
+if test -e /bin/vfio-modules.sh;
+then
+    mv /bin/vfio-modules.sh /bin/vfio-modules.sh.bkp
+fi
+if test -e /bin/vfio-devices.sh;
+then
+    mv /bin/vfio-devices.sh /bin/vfio-devices.sh.bkp
+fi
 if test -e /etc/systemd/system/libvirt-nosleep@.service;
 then
     rm /etc/systemd/system/libvirt-nosleep@.service
@@ -24,6 +32,8 @@ fi
 cp systemd-no-sleep/libvirt-nosleep@.service /etc/systemd/system/libvirt-nosleep@.service
 cp hooks/vfio-startup.sh /bin/vfio-startup.sh
 cp hooks/vfio-teardown.sh /bin/vfio-teardown.sh
+cp hooks/vfio-modules.sh /bin/vfio-modules.sh
+cp hooks/vfio-devices.sh /bin/vfio-devices.sh
 cp hooks/qemu /etc/libvirt/hooks/qemu
 
 chmod +x /bin/vfio-startup.sh
@@ -0,0 +1,1776 @@
+/** @file
+  Host replay harness for InstallQemuFwCfgTables().
+
+  QemuFwCfgAcpi.c is compiled into this file, against the stand-ins in Stubs.c
+  and Include/, so that its internals can be checked as well. The harness
+  either runs a set of synthetic scenarios that model what QEMU generates, and
+  checks the installed tables, the fw_cfg traffic and the cleanup after
+  failures, or it replays a captured fw_cfg directory and reports the time and
+  allocations spent on each loader command type.
+
+    Harness [-v] [SCENARIO...]      (SCENARIO "sum8" checks LoaderSum8())
+    Harness [-v] --replay DIR [ITERATIONS]
+    Harness --bench [ROUNDS]
+
+  For --replay, DIR holds one file per fw_cfg file, at its fw_cfg name
+  ("etc/table-loader", "etc/acpi/tables", ...), as found under
+  /sys/firmware/qemu_fw_cfg/by_name/ in a guest.
+
+  --bench times the blob name lookups and the checksum kernel against what
+  they replaced, on the many-700 script and on larger synthetic inputs.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <search.h>
+#include <sys/stat.h>
+
+#include <IndustryStandard/AcpiAml.h>
+
+#include "QemuFwCfgAcpi.c"
+#include "Stubs.h"
+
+//
+// Faults injected into the synthetic linker/loader script, or into the host
+// services.
+//
+typedef enum {
+  FaultNone,
+  FaultUnknownPointee,          // AddPointer to a file that is not allocated
+  FaultChecksumOutOfRange,      // AddChecksum past the end of the blob
+  FaultMissingFile,             // Allocate of a file that fw_cfg lacks
+  FaultDuplicateAllocate,       // the same file allocated twice
+  FaultForwardReference,        // AddPointer before its pointee's Allocate
+  FaultInstallTable,            // the fourth InstallAcpiTable() call fails
+  FaultNoReservedPages,         // no reserved memory for the VBIOS region
+} SCRIPT_FAULT;
+
+//
+// Scenario flags.
+//
+#define SCENARIO_S3               BIT0    // S3 is enabled
+#define SCENARIO_VBIOS_FILE       BIT1    // offer "opt/vbios/rom" in fw_cfg
+#define SCENARIO_VBIOS_TOO_BIG    BIT2    // an "opt/vbios/rom" over the region cap
+#define SCENARIO_DIRTY_CHECKSUMS  BIT3    // leave junk in the Checksum fields
+#define SCENARIO_UNUSED_BLOB      BIT4    // allocate a blob nothing points to
+#define SCENARIO_WRITE_POINTERS   BIT5    // several pointers in one fw_cfg file
+
+typedef struct {
+  CONST CHAR8     *Name;
+  UINTN           SsdtCount;    // SSDTs on top of the vmgenid one
+  SCRIPT_FAULT    Fault;
+  UINT32          Flags;
+  EFI_STATUS      Expected;
+} SCENARIO;
+
+STATIC CONST SCENARIO  mScenarios[] = {
+  { "basic",             2, FaultNone,               0,                                     EFI_SUCCESS          },
+  { "basic-s3",          2, FaultNone,               SCENARIO_S3,                           EFI_SUCCESS          },
+  { "vbios-file",        2, FaultNone,               SCENARIO_VBIOS_FILE,                   EFI_SUCCESS          },
+  { "vbios-too-big",     2, FaultNone,               SCENARIO_VBIOS_TOO_BIG,                EFI_SUCCESS          },
+  { "dirty-checksums",   2, FaultNone,               SCENARIO_DIRTY_CHECKSUMS,              EFI_SUCCESS          },
+  { "unused-blob",       2, FaultNone,               SCENARIO_UNUSED_BLOB,                  EFI_SUCCESS          },
+  { "write-pointers",    2, FaultNone,               SCENARIO_S3 | SCENARIO_WRITE_POINTERS, EFI_SUCCESS          },
+  { "many-200",        200, FaultNone,               0,                                     EFI_SUCCESS          },
+  { "many-700-s3",     700, FaultNone,               SCENARIO_S3,                           EFI_SUCCESS          },
+  { "bad-pointee",       2, FaultUnknownPointee,     SCENARIO_S3,                           EFI_PROTOCOL_ERROR   },
+  { "bad-checksum",      2, FaultChecksumOutOfRange, 0,                                     EFI_PROTOCOL_ERROR   },
+  { "missing-file",      2, FaultMissingFile,        SCENARIO_S3,                           EFI_NOT_FOUND        },
+  { "dup-allocate",      2, FaultDuplicateAllocate,  SCENARIO_S3,                           EFI_PROTOCOL_ERROR   },
+  { "forward-ref",       2, FaultForwardReference,   SCENARIO_S3,                           EFI_PROTOCOL_ERROR   },
+  { "install-fail",      2, FaultInstallTable,       SCENARIO_S3,                           EFI_OUT_OF_RESOURCES },
+  { "vrom-nomem",        2, FaultNoReservedPages,    SCENARIO_S3,                           EFI_OUT_OF_RESOURCES },
+};
+
+//
+// The offset of the VM generation ID within "etc/vmgenid_guid".
+//
+#define VMGENID_OFFSET  40
+
+#define FACS_SIZE  64
+
+//
+// The fw_cfg file that SCENARIO_WRITE_POINTERS writes its pointers to, and
+// where. Pointer N points 16*N bytes into the DSDT.
+//
+#define MULTI_POINTER_FILE  "etc/hw_err_addr"
+
+typedef struct {
+  UINT32    Offset;
+  UINT8     Size;
+} MULTI_POINTER;
+
+STATIC CONST MULTI_POINTER  mMultiPointers[] = {
+  { 0,  4 }, { 4,  4 }, { 16, 8 }, { 24, 4 }, { 28, 4 }
+};
+
+STATIC QEMU_LOADER_ENTRY  mScript[8192];
+STATIC UINTN              mScriptLength;
+STATIC UINT8              mTables[1 << 22];
+STATIC UINTN              mTablesLength;
+STATIC UINT8              mVbios[70001];
+STATIC UINT8              mVbiosTooBig[VROM_REGION_MAX_SIZE + 1];
+
+STATIC CONST UINT8  *mExpectedRom;
+STATIC UINTN        mExpectedRomSize;
+
+STATIC
+QEMU_LOADER_ENTRY *
+AppendCommand (
+  IN UINT32  Type
+  )
+{
+  QEMU_LOADER_ENTRY  *Entry;
+
+  assert (mScriptLength < ARRAY_SIZE (mScript));
+  Entry = &mScript[mScriptLength++];
+  memset (Entry, 0, sizeof *Entry);
+  Entry->Type = Type;
+  return Entry;
+}
+
+STATIC
+VOID
+AppendAllocate (
+  IN CONST CHAR8  *File,
+  IN UINT32       Alignment,
+  IN UINT8        Zone
+  )
+{
+  QEMU_LOADER_ALLOCATE  *Allocate;
+
+  Allocate = &AppendCommand (QemuLoaderCmdAllocate)->Command.Allocate;
+  strcpy ((CHAR8 *)Allocate->File, File);
+  Allocate->Alignment = Alignment;
+  Allocate->Zone      = Zone;
+}
+
+STATIC
+VOID
+AppendAddPointer (
+  IN CONST CHAR8  *PointerFile,
+  IN CONST CHAR8  *PointeeFile,
+  IN UINTN        PointerOffset,
+  IN UINT8        PointerSize
+  )
+{
+  QEMU_LOADER_ADD_POINTER  *AddPointer;
+
+  AddPointer = &AppendCommand (QemuLoaderCmdAddPointer)->Command.AddPointer;
+  strcpy ((CHAR8 *)AddPointer->PointerFile, PointerFile);
+  strcpy ((CHAR8 *)AddPointer->PointeeFile, PointeeFile);
+  AddPointer->PointerOffset = (UINT32)PointerOffset;
+  AddPointer->PointerSize   = PointerSize;
+}
+
+STATIC
+VOID
+AppendAddChecksum (
+  IN CONST CHAR8  *File,
+  IN UINTN        ResultOffset,
+  IN UINTN        Start,
+  IN UINTN        Length
+  )
+{
+  QEMU_LOADER_ADD_CHECKSUM  *AddChecksum;
+
+  AddChecksum = &AppendCommand (QemuLoaderCmdAddChecksum)->Command.AddChecksum;
+  strcpy ((CHAR8 *)AddChecksum->File, File);
+  AddChecksum->ResultOffset = (UINT32)ResultOffset;
+  AddChecksum->Start        = (UINT32)Start;
+  AddChecksum->Length       = (UINT32)Length;
+}
+
+STATIC
+VOID
+AppendWritePointer (
+  IN CONST CHAR8  *PointerFile,
+  IN CONST CHAR8  *PointeeFile,
+  IN UINTN        PointerOffset,
+  IN UINTN        PointeeOffset,
+  IN UINT8        PointerSize
+  )
+{
+  QEMU_LOADER_WRITE_POINTER  *WritePointer;
+
+  WritePointer = &AppendCommand (QemuLoaderCmdWritePointer)->Command.WritePointer;
+  strcpy ((CHAR8 *)WritePointer->PointerFile, PointerFile);
+  strcpy ((CHAR8 *)WritePointer->PointeeFile, PointeeFile);
+  WritePointer->PointerOffset = (UINT32)PointerOffset;
+  WritePointer->PointeeOffset = (UINT32)PointeeOffset;
+  WritePointer->PointerSize   = PointerSize;
+}
+
+/**
+  Append an ACPI table with a valid header and arbitrary contents to mTables.
+  QEMU zeroes the Checksum field before asking for it to be filled in; with
+  DirtyChecksum, the field holds junk instead.
+
+  @return  The offset of the table within mTables.
+**/
+STATIC
+UINTN
+AppendTable (
+  IN CONST CHAR8  *Signature,
+  IN UINTN        Length,
+  IN UINT8        Fill,
+  IN BOOLEAN      DirtyChecksum
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+  UINTN                        Offset;
+
+  Offset        = ALIGN_VALUE (mTablesLength, 8);
+  mTablesLength = Offset + Length;
+  assert (mTablesLength <= sizeof mTables);
+
+  Header = (EFI_ACPI_DESCRIPTION_HEADER *)(mTables + Offset);
+  memset (Header, Fill, Length);
+  memcpy (&Header->Signature, Signature, 4);
+  Header->Length   = (UINT32)Length;
+  Header->Revision = 1;
+  Header->Checksum = DirtyChecksum ? 0xA5 : 0;
+  memcpy (Header->OemId, "BOCHS ", 6);
+  return Offset;
+}
+
+STATIC
+VOID
+PutTable32 (
+  IN UINTN   Offset,
+  IN UINT32  Value
+  )
+{
+  memcpy (mTables + Offset, &Value, sizeof Value);
+}
+
+/**
+  Populate the simulated fw_cfg device with a configuration shaped like the
+  one QEMU generates for a q35 guest with a vmgenid device: FACS, DSDT, FACP,
+  APIC, SSDTs and an RSDT in "etc/acpi/tables" (the RSDT also carries a second
+  pointer to the FACP), the RSDP in "etc/acpi/rsdp", and the VM generation ID
+  in "etc/vmgenid_guid", whose address is written back to QEMU.
+**/
+STATIC
+VOID
+BuildConfiguration (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  STATIC UINTN  Ssdt[8192];
+  UINT8         Guid[SIZE_4KB];
+  UINT8         Unused[3000];
+  UINT8         Rsdp[20];
+  UINTN         Facp, Dsdt, Apic, VmgenidSsdt, Rsdt;
+  UINTN         RsdtEntries, Entry, Index;
+  UINT32        RsdtAddress;
+  BOOLEAN       Dirty;
+
+  Dirty         = (Scenario->Flags & SCENARIO_DIRTY_CHECKSUMS) != 0;
+  mScriptLength = 0;
+  mTablesLength = 0;
+  memset (mTables, 0, sizeof mTables);
+
+  memset (Guid, 0, sizeof Guid);
+  for (Index = 0; Index < 16; ++Index) {
+    Guid[VMGENID_OFFSET + Index] = (UINT8)Index;
+  }
+
+  HostAddFile ("etc/vmgenid_guid", Guid, sizeof Guid);
+  HostAddFile ("etc/vmgenid_addr", NULL, sizeof (UINT64));
+  AppendAllocate ("etc/vmgenid_guid", SIZE_4KB, QemuLoaderAllocHigh);
+
+  if (Scenario->Fault == FaultForwardReference) {
+    AppendAddPointer ("etc/vmgenid_guid", "etc/acpi/rsdp", 0, 8);
+  }
+
+  //
+  // The FACS comes first, at offset 0, and has no ACPI table header.
+  //
+  memcpy (mTables, "FACS", 4);
+  PutTable32 (4, FACS_SIZE);
+  mTablesLength = FACS_SIZE;
+
+  Dsdt = AppendTable ("DSDT", 36 + 300, 0x5A, Dirty);
+  Facp = AppendTable ("FACP", 116, 0, Dirty);
+  PutTable32 (Facp + 36, 0);
+  PutTable32 (Facp + 40, (UINT32)Dsdt);
+  for (Index = 0; Index < Scenario->SsdtCount; ++Index) {
+    Ssdt[Index] = AppendTable ("SSDT", 36 + 64 + (Index % 7) * 16, (UINT8)(0x10 + Index), Dirty);
+  }
+
+  VmgenidSsdt = AppendTable ("SSDT", 36 + 16, 0, Dirty);
+  PutTable32 (VmgenidSsdt + 36, VMGENID_OFFSET);
+  Apic = AppendTable ("APIC", 36 + 44, 0x33, Dirty);
+
+  RsdtEntries = 3 + Scenario->SsdtCount + 1;
+  Rsdt        = AppendTable ("RSDT", 36 + 4 * RsdtEntries, 0, Dirty);
+  Entry       = Rsdt + 36;
+  PutTable32 (Entry, (UINT32)Facp);
+  PutTable32 (Entry + 4, (UINT32)Apic);
+  PutTable32 (Entry + 8, (UINT32)VmgenidSsdt);
+  for (Index = 0; Index < Scenario->SsdtCount; ++Index) {
+    PutTable32 (Entry + 12 + 4 * Index, (UINT32)Ssdt[Index]);
+  }
+
+  PutTable32 (Entry + 12 + 4 * Scenario->SsdtCount, (UINT32)Facp);
+  HostAddFile ("etc/acpi/tables", mTables, mTablesLength);
+
+  memset (Rsdp, 0, sizeof Rsdp);
+  memcpy (Rsdp, "RSD PTR ", 8);
+  memcpy (Rsdp + 9, "BOCHS ", 6);
+  RsdtAddress = (UINT32)Rsdt;
+  memcpy (Rsdp + 16, &RsdtAddress, sizeof RsdtAddress);
+  HostAddFile ("etc/acpi/rsdp", Rsdp, sizeof Rsdp);
+
+  AppendAllocate ("etc/acpi/tables", 64, QemuLoaderAllocHigh);
+
+  //
+  // Only checksummed, never pointed to: it gets no memory, but is still
+  // measured, between the tables and the RSDP.
+  //
+  if ((Scenario->Flags & SCENARIO_UNUSED_BLOB) != 0) {
+    for (Index = 0; Index < sizeof Unused; ++Index) {
+      Unused[Index] = (UINT8)(Index ^ (Index >> 8));
+    }
+
+    HostAddFile ("etc/unused", Unused, sizeof Unused);
+    AppendAllocate ("etc/unused", 64, QemuLoaderAllocHigh);
+    AppendAddChecksum ("etc/unused", 0, 0, sizeof Unused);
+  }
+
+  AppendAllocate ("etc/acpi/rsdp", 16, QemuLoaderAllocFSeg);
+  AppendAddPointer ("etc/acpi/tables", "etc/acpi/tables", Facp + 36, 4);
+  AppendAddPointer ("etc/acpi/tables", "etc/acpi/tables", Facp + 40, 4);
+  AppendAddChecksum ("etc/acpi/tables", Dsdt + 9, Dsdt, 36 + 300);
+  AppendAddChecksum ("etc/acpi/tables", Facp + 9, Facp, 116);
+  for (Index = 0; Index < Scenario->SsdtCount; ++Index) {
+    AppendAddChecksum (
+      "etc/acpi/tables",
+      Ssdt[Index] + 9,
+      Ssdt[Index],
+      ((EFI_ACPI_DESCRIPTION_HEADER *)(mTables + Ssdt[Index]))->Length
+      );
+  }
+
+  AppendAddPointer ("etc/acpi/tables", "etc/vmgenid_guid", VmgenidSsdt + 36, 4);
+  AppendAddChecksum ("etc/acpi/tables", VmgenidSsdt + 9, VmgenidSsdt, 36 + 16);
+  AppendWritePointer ("etc/vmgenid_addr", "etc/vmgenid_guid", 0, VMGENID_OFFSET, 8);
+
+  //
+  // Five pointers into one file, as in "etc/hw_err_addr"-like setups. The
+  // writes at 0 and 4, and at 24 and 28, are adjacent, so the S3 boot script
+  // needs three writes for them rather than five.
+  //
+  if ((Scenario->Flags & SCENARIO_WRITE_POINTERS) != 0) {
+    HostAddFile (MULTI_POINTER_FILE, NULL, 32);
+    for (Index = 0; Index < ARRAY_SIZE (mMultiPointers); ++Index) {
+      AppendWritePointer (
+        MULTI_POINTER_FILE,
+        "etc/acpi/tables",
+        mMultiPointers[Index].Offset,
+        Dsdt + 16 * Index,
+        mMultiPointers[Index].Size
+        );
+    }
+  }
+
+  if (Scenario->Fault == FaultUnknownPointee) {
+    AppendAddPointer ("etc/acpi/tables", "etc/nonexistent", 0, 4);
+  }
+
+  AppendAddChecksum ("etc/acpi/tables", Apic + 9, Apic, 36 + 44);
+  for (Index = 0; Index < RsdtEntries; ++Index) {
+    AppendAddPointer ("etc/acpi/tables", "etc/acpi/tables", Entry + 4 * Index, 4);
+  }
+
+  AppendAddChecksum ("etc/acpi/tables", Rsdt + 9, Rsdt, 36 + 4 * RsdtEntries);
+  AppendAddPointer ("etc/acpi/rsdp", "etc/acpi/tables", 16, 4);
+  AppendAddChecksum ("etc/acpi/rsdp", 8, 0, 20);
+
+  switch (Scenario->Fault) {
+    case FaultMissingFile:
+      AppendAllocate ("etc/missing", 64, QemuLoaderAllocHigh);
+      break;
+    case FaultDuplicateAllocate:
+      AppendAllocate ("etc/acpi/rsdp", 16, QemuLoaderAllocFSeg);
+      break;
+    case FaultChecksumOutOfRange:
+      AppendAddChecksum ("etc/acpi/rsdp", 100, 0, 20);
+      break;
+    default:
+      break;
+  }
+
+  HostAddFile ("etc/table-loader", mScript, mScriptLength * sizeof mScript[0]);
+
+  mExpectedRom     = VROM_BIN;
+  mExpectedRomSize = VROM_BIN_LEN;
+  if ((Scenario->Flags & SCENARIO_VBIOS_FILE) != 0) {
+    for (Index = 0; Index < sizeof mVbios; ++Index) {
+      mVbios[Index] = (UINT8)(Index * 7 + 3);
+    }
+
+    HostAddFile (VROM_FW_CFG_FILE, mVbios, sizeof mVbios);
+    mExpectedRom     = mVbios;
+    mExpectedRomSize = sizeof mVbios;
+  }
+
+  //
+  // Too large to expose without truncating it: no VBIOS SSDT at all.
+  //
+  if ((Scenario->Flags & SCENARIO_VBIOS_TOO_BIG) != 0) {
+    HostAddFile (VROM_FW_CFG_FILE, mVbiosTooBig, sizeof mVbiosTooBig);
+    mExpectedRom     = NULL;
+    mExpectedRomSize = 0;
+  }
+}
+
+/**
+  Find OperationRegion (VBOR) in the installed tables, and check that it maps
+  a copy of the VBIOS image.
+**/
+STATIC
+BOOLEAN
+CheckVbor (
+  VOID
+  )
+{
+  HOST_TABLE  *Table;
+  UINT8       *Aml;
+  UINT64      Address;
+  UINT64      Length;
+  UINTN       Index, Offset;
+  BOOLEAN     Ok;
+
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    Table = &gHostTables[Index];
+    if (!Table->Live) {
+      continue;
+    }
+
+    for (Offset = 0; Offset + 16 < Table->Size; ++Offset) {
+      if (memcmp (Table->Data + Offset, "\x5B\x80VBOR\x00", 7) != 0) {
+        continue;
+      }
+
+      Aml     = Table->Data + Offset + 7;
+      Address = 0;
+      Length  = 0;
+      switch (*Aml) {
+        case AML_DWORD_PREFIX:
+          memcpy (&Address, Aml + 1, 4);
+          Aml += 5;
+          break;
+        default:
+          printf ("  vbor: unexpected address encoding 0x%02x\n", *Aml);
+          return FALSE;
+      }
+
+      switch (*Aml) {
+        case AML_BYTE_PREFIX:
+          Length = Aml[1];
+          break;
+        case AML_WORD_PREFIX:
+          memcpy (&Length, Aml + 1, 2);
+          break;
+        case AML_DWORD_PREFIX:
+          memcpy (&Length, Aml + 1, 4);
+          break;
+        default:
+          printf ("  vbor: unexpected length encoding 0x%02x\n", *Aml);
+          return FALSE;
+      }
+
+      //
+      // AML Integers are 32 bits wide under QEMU's revision 1 DSDT, so the
+      // region must be below 4GB, and the SSDT must not claim revision 2.
+      //
+      Ok = (((EFI_ACPI_DESCRIPTION_HEADER *)Table->Data)->Revision == 1) &&
+           (Address + Length - 1 <= MAX_UINT32) &&
+           (Length >= mExpectedRomSize) && (Length % VROM_REGION_ALIGNMENT == 0) &&
+           (memcmp ((VOID *)(UINTN)Address, mExpectedRom, mExpectedRomSize) == 0);
+      printf (
+        "  vbor: address=0x%llx length=0x%llx %s\n",
+        (unsigned long long)Address,
+        (unsigned long long)Length,
+        Ok ? "ok" : "BAD"
+        );
+      return Ok;
+    }
+  }
+
+  printf ("  vbor: missing\n");
+  return FALSE;
+}
+
+//
+// A small AML decoder for the VBIOS SSDT. It walks the definition block,
+// validates every PkgLength (consistent with its contents, and in its shortest
+// encoding), and records the values that CheckVromSsdt() cross-checks.
+//
+typedef struct {
+  BOOLEAN    Bad;
+  CHAR8      Scope[64];
+  UINT64     RegionLength;
+  UINT64     FieldBits;
+  UINT64     Rvbs;
+  CHAR8      Log[4096];
+} AML_DECODE;
+
+STATIC AML_DECODE  mAml;
+
+STATIC
+VOID
+AmlLog (
+  IN CONST CHAR8  *Text
+  )
+{
+  strncat (mAml.Log, Text, sizeof mAml.Log - strlen (mAml.Log) - 1);
+}
+
+STATIC
+UINT8 *
+DecodePkgLength (
+  IN  UINT8  *Aml,
+  OUT UINT8  **End
+  )
+{
+  UINTN  Extra;
+  UINTN  Length;
+  UINTN  Index;
+
+  Extra = Aml[0] >> 6;
+  if (Extra == 0) {
+    Length = Aml[0] & 0x3F;
+  } else {
+    Length = Aml[0] & 0x0F;
+    for (Index = 1; Index <= Extra; ++Index) {
+      Length |= (UINTN)Aml[Index] << (4 + 8 * (Index - 1));
+    }
+
+    if (Length < ((Extra == 1) ? 0x40 : (Extra == 2) ? 0x1000 : 0x100000)) {
+      AmlLog (" [PkgLength not minimal]");
+      mAml.Bad = TRUE;
+    }
+  }
+
+  if (End != NULL) {
+    *End = Aml + Length;
+  }
+
+  return Aml + Extra + 1;
+}
+
+STATIC
+UINT8 *
+DecodeNameString (
+  IN  UINT8  *Aml,
+  OUT CHAR8  *Name
+  )
+{
+  UINTN  Segments;
+  UINTN  Index;
+
+  Name[0] = '\0';
+  while (*Aml == AML_ROOT_CHAR || *Aml == AML_PARENT_PREFIX_CHAR) {
+    strncat (Name, (CHAR8 *)Aml++, 1);
+  }
+
+  if (*Aml == AML_ZERO_OP) {
+    return Aml + 1;
+  }
+
+  Segments = 1;
+  if (*Aml == AML_DUAL_NAME_PREFIX) {
+    Segments = 2;
+    ++Aml;
+  } else if (*Aml == AML_MULTI_NAME_PREFIX) {
+    Segments = Aml[1];
+    Aml     += 2;
+  }
+
+  for (Index = 0; Index < Segments; ++Index) {
+    if (Index > 0) {
+      strcat (Name, ".");
+    }
+
+    strncat (Name, (CHAR8 *)Aml, 4);
+    Aml += 4;
+  }
+
+  return Aml;
+}
+
+STATIC
+UINT8 *
+DecodeInteger (
+  IN  UINT8   *Aml,
+  OUT UINT64  *Value
+  )
+{
+  *Value = 0;
+  switch (*Aml) {
+    case AML_ZERO_OP:
+      return Aml + 1;
+    case AML_ONE_OP:
+      *Value = 1;
+      return Aml + 1;
+    case AML_BYTE_PREFIX:
+      memcpy (Value, Aml + 1, 1);
+      return Aml + 2;
+    case AML_WORD_PREFIX:
+      memcpy (Value, Aml + 1, 2);
+      return Aml + 3;
+    case AML_DWORD_PREFIX:
+      memcpy (Value, Aml + 1, 4);
+      return Aml + 5;
+    default:
+      return NULL;
+  }
+}
+
+STATIC
+UINT8 *
+DecodeTerm (
+  IN UINT8  *Aml
+  );
+
+//
+// TermArg, SuperName or Target.
+//
+STATIC
+UINT8 *
+DecodeOperand (
+  IN UINT8  *Aml
+  )
+{
+  CHAR8   Text[80];
+  UINT64  Value;
+  UINT8   *Next;
+
+  if ((*Aml >= AML_LOCAL0) && (*Aml <= AML_ARG0 + 6)) {
+    snprintf (Text, sizeof Text, " %s%u", (*Aml >= AML_ARG0) ? "Arg" : "Local", *Aml & 7);
+    AmlLog (Text);
+    return Aml + 1;
+  }
+
+  Next = DecodeInteger (Aml, &Value);
+  if (Next != NULL) {
+    snprintf (Text, sizeof Text, " 0x%llx", (unsigned long long)Value);
+    AmlLog (Text);
+    return Next;
+  }
+
+  if ((*Aml == AML_ROOT_CHAR) || (*Aml == AML_PARENT_PREFIX_CHAR) || (*Aml == '_') ||
+      ((*Aml >= 'A') && (*Aml <= 'Z')) ||
+      (*Aml == AML_DUAL_NAME_PREFIX) || (*Aml == AML_MULTI_NAME_PREFIX))
+  {
+    Text[0] = ' ';
+    Next    = DecodeNameString (Aml, Text + 1);
+    AmlLog (Text);
+    return Next;
+  }
+
+  return DecodeTerm (Aml);
+}
+
+STATIC
+UINT8 *
+DecodeTermList (
+  IN UINT8  *Aml,
+  IN UINT8  *End
+  )
+{
+  while (Aml != NULL && Aml < End) {
+    Aml = DecodeTerm (Aml);
+  }
+
+  if (Aml != End) {
+    AmlLog (" [overrun]");
+    mAml.Bad = TRUE;
+    return NULL;
+  }
+
+  return End;
+}
+
+STATIC
+UINT8 *
+DecodeTerm (
+  IN UINT8  *Aml
+  )
+{
+  CHAR8  Name[64];
+  CHAR8  Text[96];
+  UINT8  *End;
+  UINTN  Operands;
+
+  Operands = 0;
+  switch (*Aml) {
+    case AML_EXT_OP:
+      if (Aml[1] == AML_EXT_REGION_OP) {
+        Aml = DecodeNameString (Aml + 2, Name);
+        snprintf (Text, sizeof Text, " OperationRegion(%s,%u,", Name, *Aml);
+        AmlLog (Text);
+        Aml = DecodeOperand (Aml + 1);
+        Aml = DecodeInteger (Aml, &mAml.RegionLength);
+        snprintf (Text, sizeof Text, ",0x%llx)", (unsigned long long)mAml.RegionLength);
+        AmlLog (Text);
+        return Aml;
+      }
+
+      if (Aml[1] == AML_EXT_FIELD_OP) {
+        Aml = DecodePkgLength (Aml + 2, &End);
+        Aml = DecodeNameString (Aml, Name);
+        snprintf (Text, sizeof Text, " Field(%s,%u){", Name, *Aml++);
+        AmlLog (Text);
+        while (Aml < End) {
+          //
+          // NamedField: NameSeg followed by the width in bits as a PkgLength.
+          //
+          snprintf (Text, sizeof Text, " %.4s", (CHAR8 *)Aml);
+          AmlLog (Text);
+          DecodePkgLength (Aml + 4, NULL);
+          mAml.FieldBits = (Aml[4] >> 6 == 0) ? (Aml[4] & 0x3F) : (Aml[4] & 0x0F);
+          for (Operands = 1; Operands <= (UINTN)(Aml[4] >> 6); ++Operands) {
+            mAml.FieldBits |= (UINT64)Aml[4 + Operands] << (4 + 8 * (Operands - 1));
+          }
+
+          Aml = DecodePkgLength (Aml + 4, NULL);
+        }
+
+        AmlLog (" }");
+        return End;
+      }
+
+      break;
+
+    case AML_NAME_OP:
+      Aml = DecodeNameString (Aml + 1, Name);
+      snprintf (Text, sizeof Text, " Name(%s,", Name);
+      AmlLog (Text);
+      if (strcmp (Name, "RVBS") == 0) {
+        DecodeInteger (Aml, &mAml.Rvbs);
+      }
+
+      Aml = DecodeOperand (Aml);
+      AmlLog (")");
+      return Aml;
+
+    case AML_SCOPE_OP:
+    case AML_METHOD_OP:
+      Operands = (*Aml == AML_METHOD_OP);
+      Aml      = DecodePkgLength (Aml + 1, &End);
+      Aml      = DecodeNameString (Aml, Name);
+      if (Operands == 0) {
+        snprintf (mAml.Scope, sizeof mAml.Scope, "%s", Name);
+      }
+
+      snprintf (Text, sizeof Text, " %s(%s){", Operands ? "Method" : "Scope", Name);
+      AmlLog (Text);
+      Aml = DecodeTermList (Aml + Operands, End);
+      AmlLog (" }");
+      return Aml;
+
+    case AML_IF_OP:
+      Aml = DecodePkgLength (Aml + 1, &End);
+      AmlLog (" If(");
+      Aml = DecodeOperand (Aml);
+      AmlLog ("){");
+      Aml = DecodeTermList (Aml, End);
+      AmlLog (" }");
+      return Aml;
+
+    case AML_BUFFER_OP:
+      Aml = DecodePkgLength (Aml + 1, &End);
+      AmlLog (" Buffer(");
+      DecodeOperand (Aml);
+      AmlLog (")");
+      return End;
+
+    case AML_STORE_OP:
+    case AML_LGREATER_OP:
+    case AML_LLESS_OP:
+      Operands = 2;
+      break;
+
+    case AML_ADD_OP:
+    case AML_SUBTRACT_OP:
+      Operands = 3;
+      break;
+
+    case AML_MID_OP:
+      Operands = 4;
+      break;
+
+    case AML_LNOT_OP:
+    case AML_RETURN_OP:
+      Operands = 1;
+      break;
+  }
+
+  if (Operands == 0) {
+    snprintf (Text, sizeof Text, " [unexpected opcode 0x%02x]", *Aml);
+    AmlLog (Text);
+    mAml.Bad = TRUE;
+    return NULL;
+  }
+
+  snprintf (Text, sizeof Text, " op%02x(", *Aml);
+  AmlLog (Text);
+  for (++Aml; Operands > 0 && Aml != NULL; --Operands) {
+    Aml = DecodeOperand (Aml);
+  }
+
+  AmlLog (")");
+  return Aml;
+}
+
+/**
+  Decode the VBIOS SSDT, and check it against the image that was offered.
+**/
+STATIC
+BOOLEAN
+CheckVromSsdt (
+  VOID
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+  UINTN                        Index;
+  BOOLEAN                      Ok;
+
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    Header = (EFI_ACPI_DESCRIPTION_HEADER *)gHostTables[Index].Data;
+    if (!gHostTables[Index].Live || (memcmp (Header->OemId, "REDHAT", 6) != 0)) {
+      continue;
+    }
+
+    memset (&mAml, 0, sizeof mAml);
+    if (DecodeTermList ((UINT8 *)(Header + 1), (UINT8 *)Header + Header->Length) == NULL) {
+      mAml.Bad = TRUE;
+    }
+
+    Ok = !mAml.Bad && (Header->Length == gHostTables[Index].Size) &&
+         (mAml.Rvbs == mExpectedRomSize) &&
+         (mAml.FieldBits == mAml.RegionLength * 8) &&
+         (strcmp (mAml.Scope, "\\_SB_.PCI0.S08_") == 0);
+    printf (
+      "  ssdt: length=%u RVBS=%llu scope=%s %s\n",
+      Header->Length,
+      (unsigned long long)mAml.Rvbs,
+      mAml.Scope,
+      Ok ? "ok" : "BAD"
+      );
+    if (!Ok || (gHostVerbosity > 0)) {
+      printf ("  aml:%s\n", mAml.Log);
+    }
+
+    return Ok;
+  }
+
+  printf ("  ssdt: missing\n");
+  return FALSE;
+}
+
+/**
+  Check that an image that was not exposed has left neither an SSDT nor
+  reserved memory behind.
+**/
+STATIC
+BOOLEAN
+CheckNoVrom (
+  VOID
+  )
+{
+  EFI_ACPI_DESCRIPTION_HEADER  *Header;
+  UINTN                        Index;
+  UINTN                        Reserved;
+  BOOLEAN                      Ok;
+
+  Ok = TRUE;
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    Header = (EFI_ACPI_DESCRIPTION_HEADER *)gHostTables[Index].Data;
+    if (gHostTables[Index].Live && (strcmp (gHostTables[Index].Signature, "SSDT") == 0) &&
+        (memcmp (Header->OemId, "REDHAT", 6) == 0))
+    {
+      Ok = FALSE;
+    }
+  }
+
+  //
+  // Only the statistics record, if any, is left in reserved memory.
+  //
+  Reserved = HostPagesOutstanding (EfiReservedMemoryType);
+  Ok      &= (Reserved == (LOADER_STATS_PUBLISH ? EFI_SIZE_TO_PAGES (sizeof (LOADER_STATS_RECORD)) : 0));
+  printf ("  ssdt: not exposed, %lu reserved pages %s\n", (unsigned long)Reserved, Ok ? "ok" : "BAD");
+  return Ok;
+}
+
+/**
+  Replay the S3 boot script over zeroed copies of the files it writes to; the
+  result has to match what the loader wrote at normal boot.
+**/
+STATIC
+BOOLEAN
+CheckS3Replay (
+  VOID
+  )
+{
+  STATIC UINT8  Saved[HOST_MAX_FILES][64];
+  BOOLEAN       Touched[HOST_MAX_FILES];
+  HOST_FILE     *File;
+  UINTN         Index;
+  BOOLEAN       Match;
+
+  memset (Touched, 0, sizeof Touched);
+  for (Index = 0; Index < gHostS3WriteCount; ++Index) {
+    File = &gHostFiles[gHostS3Writes[Index].Item - HOST_FIRST_FILE_ITEM];
+    if (!Touched[File - gHostFiles]) {
+      assert (File->Size <= sizeof Saved[0]);
+      memcpy (Saved[File - gHostFiles], File->Data, File->Size);
+      memset (File->Data, 0, File->Size);
+      Touched[File - gHostFiles] = TRUE;
+    }
+  }
+
+  for (Index = 0; Index < gHostS3WriteCount; ++Index) {
+    QemuFwCfgSelectItem (gHostS3Writes[Index].Item);
+    QemuFwCfgSkipBytes (gHostS3Writes[Index].Offset);
+    QemuFwCfgWriteBytes (gHostS3Writes[Index].Size, &gHostS3Writes[Index].Value);
+  }
+
+  Match = TRUE;
+  for (Index = 0; Index < gHostFileCount; ++Index) {
+    if (Touched[Index]) {
+      Match &= (memcmp (Saved[Index], gHostFiles[Index].Data, gHostFiles[Index].Size) == 0);
+    }
+  }
+
+  printf ("  s3: %lu writes, replay %s\n", (unsigned long)gHostS3WriteCount, Match ? "matches" : "DIFFERS");
+
+  //
+  // The context is sized from the condensed writes, not from the commands.
+  //
+  if (gHost.S3ContextCapacity != gHostS3WriteCount) {
+    printf ("  s3: context sized for %lu writes\n", (unsigned long)gHost.S3ContextCapacity);
+    Match = FALSE;
+  }
+
+  return Match;
+}
+
+/**
+  Check the pointers that SCENARIO_WRITE_POINTERS has QEMU write back: each one
+  must point 16 bytes past the previous one, and the adjacent ones must have
+  been coalesced for S3.
+**/
+STATIC
+BOOLEAN
+CheckWritePointers (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  HOST_FILE  *File;
+  UINT64     First;
+  UINT64     Value;
+  UINTN      Index;
+  BOOLEAN    Ok;
+
+  if ((Scenario->Flags & SCENARIO_WRITE_POINTERS) == 0) {
+    return TRUE;
+  }
+
+  File  = HostFindFile (MULTI_POINTER_FILE);
+  First = 0;
+  Ok    = TRUE;
+  for (Index = 0; Index < ARRAY_SIZE (mMultiPointers); ++Index) {
+    Value = 0;
+    memcpy (&Value, File->Data + mMultiPointers[Index].Offset, mMultiPointers[Index].Size);
+    if (Index == 0) {
+      First = Value;
+    }
+
+    Ok &= (Value != 0) && (Value - First == 16 * Index);
+  }
+
+  //
+  // The vmgenid pointer, 0+4, 16, and 24+28.
+  //
+  Ok &= (gHostS3WriteCount == 4);
+  printf ("  write-pointers: first=0x%llx s3-writes=%lu %s\n", (unsigned long long)First, (unsigned long)gHostS3WriteCount, Ok ? "ok" : "BAD");
+  return Ok;
+}
+
+/**
+  Check that the script and every blob it allocates have been downloaded in
+  a single pass each: one lookup, one select, and exactly their size in bytes
+  read.
+**/
+STATIC
+BOOLEAN
+CheckDownloadedOnce (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  HOST_FILE  *File;
+  UINTN      Index;
+  BOOLEAN    Ok;
+
+  //
+  // Blob names are resolved through the loader's own index; fw_cfg is only
+  // asked once per blob. (WritePointer targets are not blobs, and are looked
+  // up by each command that writes to them.)
+  //
+  Ok = TRUE;
+  for (Index = 0; Index <= mScriptLength; ++Index) {
+    if (Index == mScriptLength) {
+      File = HostFindFile ("etc/table-loader");
+    } else if (mScript[Index].Type == QemuLoaderCmdAllocate) {
+      File = HostFindFile ((CHAR8 *)mScript[Index].Command.Allocate.File);
+    } else {
+      continue;
+    }
+
+    if (File->Lookups > 1) {
+      printf ("  %s: looked up %lu times\n", File->Name, (unsigned long)File->Lookups);
+      Ok = FALSE;
+    }
+
+    if ((File->Selects != 1) || (File->ReadBytes != File->Size)) {
+      printf (
+        "  %s: %lu selects, %lu of %lu bytes read\n",
+        File->Name,
+        (unsigned long)File->Selects,
+        (unsigned long)File->ReadBytes,
+        (unsigned long)File->Size
+        );
+      Ok = FALSE;
+    }
+  }
+
+  return Ok;
+}
+
+/**
+  Check that PCR[1] got one ACPI data event per fw_cfg item, with the
+  contents as QEMU offered them: the script, every blob in Allocate order,
+  then the VBIOS image if it came from fw_cfg. This is the event log of the
+  original two-pass code.
+**/
+STATIC
+BOOLEAN
+CheckMeasured (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  HOST_FILE         *Expected[HOST_MAX_MEASUREMENTS];
+  UINTN             ExpectedCount;
+  HOST_MEASUREMENT  *Measurement;
+  UINTN             Index;
+  BOOLEAN           Ok;
+
+  ExpectedCount             = 0;
+  Expected[ExpectedCount++] = HostFindFile ("etc/table-loader");
+  for (Index = 0; Index < mScriptLength; ++Index) {
+    if (mScript[Index].Type == QemuLoaderCmdAllocate) {
+      Expected[ExpectedCount++] = HostFindFile ((CHAR8 *)mScript[Index].Command.Allocate.File);
+    }
+  }
+
+  if ((Scenario->Flags & SCENARIO_VBIOS_FILE) != 0) {
+    Expected[ExpectedCount++] = HostFindFile (VROM_FW_CFG_FILE);
+  }
+
+  Ok = (gHostMeasurementCount == ExpectedCount);
+  for (Index = 0; Ok && Index < ExpectedCount; ++Index) {
+    Measurement = &gHostMeasurements[Index];
+    if ((Measurement->PcrIndex != 1) ||
+        (Measurement->EventType != EV_PLATFORM_CONFIG_FLAGS) ||
+        (Measurement->Size != Expected[Index]->Size) ||
+        (Measurement->Crc != CalculateCrc32 (Expected[Index]->Data, Expected[Index]->Size)))
+    {
+      printf ("  tpm: event %lu does not match %s\n", (unsigned long)Index, Expected[Index]->Name);
+      Ok = FALSE;
+    }
+  }
+
+  printf ("  tpm: %lu events, %lu expected%s\n", (unsigned long)gHostMeasurementCount, (unsigned long)ExpectedCount, Ok ? "" : ", MISMATCH");
+  return Ok;
+}
+
+/**
+  Check the outcome of a successful InstallQemuFwCfgTables() call.
+**/
+STATIC
+BOOLEAN
+CheckInstalled (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  HOST_TABLE  *Table;
+  UINT64      VmgenidAddress;
+  UINT32      Facs, Dsdt;
+  UINTN       Index;
+  BOOLEAN     Ok;
+
+  //
+  // FACS, DSDT, FACP, APIC, the vmgenid SSDT, the other SSDTs, the VBIOS
+  // SSDT unless the image is left out, and the statistics table if built with
+  // PUBLISH_LOADER_STATS.
+  //
+  Ok = (HostLiveTables () == 5 + Scenario->SsdtCount + (mExpectedRom != NULL ? 1 : 0) +
+                             (LOADER_STATS_PUBLISH ? 1 : 0));
+
+  memcpy (&VmgenidAddress, HostFindFile ("etc/vmgenid_addr")->Data, sizeof VmgenidAddress);
+  if ((VmgenidAddress == 0) ||
+      (memcmp ((VOID *)(UINTN)VmgenidAddress, HostFindFile ("etc/vmgenid_guid")->Data + VMGENID_OFFSET, 16) != 0))
+  {
+    printf ("  vmgenid: address not written back\n");
+    Ok = FALSE;
+  }
+
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    Table = &gHostTables[Index];
+    if (!Table->Live || (strcmp (Table->Signature, "FACS") == 0)) {
+      continue;
+    }
+
+    if (CalculateSum8 (Table->Data, Table->Size) != 0) {
+      printf ("  %s: bad checksum\n", Table->Signature);
+      Ok = FALSE;
+    }
+
+    //
+    // The FACP is reached twice; its pointers must be patched exactly once.
+    //
+    if (strcmp (Table->Signature, "FACP") == 0) {
+      memcpy (&Facs, Table->Data + 36, sizeof Facs);
+      memcpy (&Dsdt, Table->Data + 40, sizeof Dsdt);
+      if ((Facs == 0) || (Dsdt - Facs != FACS_SIZE)) {
+        printf ("  FACP: bad FIRMWARE_CTRL/DSDT\n");
+        Ok = FALSE;
+      }
+    }
+  }
+
+  Ok &= CheckDownloadedOnce (Scenario);
+  Ok &= CheckMeasured (Scenario);
+  if (mExpectedRom != NULL) {
+    Ok &= CheckVbor ();
+    Ok &= CheckVromSsdt ();
+  } else {
+    Ok &= CheckNoVrom ();
+  }
+
+  Ok &= CheckWritePointers (Scenario);
+  if (gHostS3WriteCount > 0) {
+    Ok &= CheckS3Replay ();
+  }
+
+  return Ok;
+}
+
+/**
+  Check that a failed InstallQemuFwCfgTables() call has left nothing behind.
+**/
+STATIC
+BOOLEAN
+CheckRolledBack (
+  VOID
+  )
+{
+  UINT64   VmgenidAddress;
+  BOOLEAN  Ok;
+
+  memcpy (&VmgenidAddress, HostFindFile ("etc/vmgenid_addr")->Data, sizeof VmgenidAddress);
+  Ok = (HostLiveTables () == 0) && (VmgenidAddress == 0) &&
+       (HostPagesOutstanding (EfiACPIMemoryNVS) == 0) &&
+       (HostPagesOutstanding (EfiReservedMemoryType) == 0) &&
+       (gHost.NotifyInstalled == 0);
+  if (!Ok) {
+    printf ("  rollback: incomplete\n");
+  }
+
+  return Ok;
+}
+
+STATIC
+VOID
+PrintTables (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  printf ("  tables:");
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    if (gHostTables[Index].Live) {
+      printf (" %s/%lu", gHostTables[Index].Signature, (unsigned long)gHostTables[Index].Size);
+    }
+  }
+
+  printf ("\n  measurements:");
+  for (Index = 0; Index < gHostMeasurementCount; ++Index) {
+    printf (" %lu:%08x", (unsigned long)gHostMeasurements[Index].Size, gHostMeasurements[Index].Crc);
+  }
+
+  printf ("\n");
+}
+
+/**
+  Print the per-command accounting of the last InstallQemuFwCfgTables() call.
+**/
+STATIC
+VOID
+PrintLoaderStats (
+  IN UINTN  Iterations
+  )
+{
+  LOADER_STAT_TYPE  Type;
+  LOADER_STAT       *Stat;
+  LOADER_PHASE      Phase;
+
+  printf ("  %-14s %8s %12s %11s %8s %11s\n", "command", "count", "time(ns)", "page-allocs", "pages", "pool-allocs");
+  for (Type = 0; Type < LoaderStatMax; ++Type) {
+    Stat = &mLoaderStats[Type];
+    printf (
+      "  %-14s %8u %12llu %11u %8llu %11u\n",
+      mLoaderStatName[Type],
+      Stat->Count,
+      (unsigned long long)(GetTimeInNanoSecond (Stat->Ticks) / Iterations),
+      Stat->PageAllocations,
+      (unsigned long long)Stat->Pages,
+      Stat->PoolAllocations
+      );
+  }
+
+  for (Phase = 0; Phase < LoaderPhaseMax; ++Phase) {
+    printf (
+      "  phase %-14s %12llu ns\n",
+      mLoaderPhaseName[Phase],
+      (unsigned long long)(GetTimeInNanoSecond (mLoaderPhaseTicks[Phase]) / Iterations)
+      );
+  }
+}
+
+STATIC
+BOOLEAN
+RunScenario (
+  IN CONST SCENARIO  *Scenario
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Start;
+  UINT64      Elapsed;
+  BOOLEAN     Ok;
+
+  HostReset ();
+  gHost.S3Enabled         = (Scenario->Flags & SCENARIO_S3) != 0;
+  gHost.FailInstallAfter  = (Scenario->Fault == FaultInstallTable) ? 3 : -1;
+  gHost.FailReservedPages = (Scenario->Fault == FaultNoReservedPages);
+  BuildConfiguration (Scenario);
+
+  Start   = GetPerformanceCounter ();
+  Status  = InstallQemuFwCfgTables (&gHostAcpiTable);
+  Elapsed = GetPerformanceCounter () - Start;
+
+  printf (
+    "%-16s status=%s tables=%lu xsdt-rebuilds=%lu fwcfg-selects=%lu fwcfg-bytes=%lu "
+    "lookups=%lu pool-allocs=%lu pool-peak=%lu page-allocs=%lu time=%lluus\n",
+    Scenario->Name,
+    (Status == EFI_SUCCESS) ? "success" : "error",
+    (unsigned long)HostLiveTables (),
+    (unsigned long)gHost.XsdtRebuilds,
+    (unsigned long)gHost.FwCfgSelects,
+    (unsigned long)gHost.FwCfgReadBytes,
+    (unsigned long)gHost.FindFileCalls,
+    (unsigned long)gHost.PoolAllocations,
+    (unsigned long)gHost.PoolPeakBytes,
+    (unsigned long)gHost.PageAllocations,
+    (unsigned long long)(Elapsed / 1000)
+    );
+
+  Ok = (Status == Scenario->Expected);
+  if (!Ok) {
+    printf ("  status: 0x%lx, expected 0x%lx\n", (unsigned long)Status, (unsigned long)Scenario->Expected);
+  }
+
+  if (gHost.PoolOutstanding != 0) {
+    printf ("  pool: %ld allocations leaked\n", (long)gHost.PoolOutstanding);
+    Ok = FALSE;
+  }
+
+  if (gHost.PciDecodingDepth != 0) {
+    printf ("  pci: decoding not restored\n");
+    Ok = FALSE;
+  }
+
+  if (Scenario->Expected == EFI_SUCCESS) {
+    Ok &= CheckInstalled (Scenario);
+  } else {
+    Ok &= CheckRolledBack ();
+  }
+
+  if (!Ok || (gHostVerbosity > 0)) {
+    PrintTables ();
+    PrintLoaderStats (1);
+  }
+
+  printf ("  => %s\n", Ok ? "PASS" : "FAIL");
+  return Ok;
+}
+
+/**
+  Add every regular file under Root to the simulated fw_cfg device, named by
+  its path relative to Root.
+**/
+STATIC
+VOID
+LoadDirectory (
+  IN CONST CHAR8  *Root,
+  IN CONST CHAR8  *Prefix
+  )
+{
+  CHAR8          Path[4096];
+  CHAR8          Name[1024];
+  DIR            *Dir;
+  struct dirent  *Dirent;
+  struct stat    Stat;
+  FILE           *Stream;
+  UINT8          *Data;
+
+  snprintf (Path, sizeof Path, "%s/%s", Root, Prefix);
+  Dir = opendir (Path);
+  if (Dir == NULL) {
+    perror (Path);
+    exit (2);
+  }
+
+  while ((Dirent = readdir (Dir)) != NULL) {
+    if (Dirent->d_name[0] == '.') {
+      continue;
+    }
+
+    snprintf (Name, sizeof Name, "%s%s%s", Prefix, (*Prefix != '\0') ? "/" : "", Dirent->d_name);
+    snprintf (Path, sizeof Path, "%s/%s", Root, Name);
+    if (stat (Path, &Stat) != 0) {
+      continue;
+    }
+
+    if (S_ISDIR (Stat.st_mode)) {
+      LoadDirectory (Root, Name);
+      continue;
+    }
+
+    if (strlen (Name) >= QEMU_LOADER_FNAME_SIZE) {
+      fprintf (stderr, "%s: name too long for fw_cfg, skipped\n", Name);
+      continue;
+    }
+
+    Data   = malloc (Stat.st_size + 1);
+    Stream = fopen (Path, "rb");
+    if ((Data == NULL) || (Stream == NULL) ||
+        (fread (Data, 1, Stat.st_size, Stream) != (size_t)Stat.st_size))
+    {
+      perror (Path);
+      exit (2);
+    }
+
+    fclose (Stream);
+    HostAddFile (Name, Data, Stat.st_size);
+    free (Data);
+  }
+
+  closedir (Dir);
+}
+
+STATIC
+INT32
+Replay (
+  IN CONST CHAR8  *Root,
+  IN UINTN        Iterations
+  )
+{
+  LOADER_STAT  Totals[LoaderStatMax];
+  UINT64       PhaseTotals[LoaderPhaseMax];
+  EFI_STATUS   Status;
+  UINT64       Start;
+  UINT64       Elapsed;
+  UINTN        Iteration;
+
+  memset (Totals, 0, sizeof Totals);
+  memset (PhaseTotals, 0, sizeof PhaseTotals);
+  Elapsed = 0;
+  Status  = EFI_SUCCESS;
+  for (Iteration = 0; Iteration < Iterations; ++Iteration) {
+    HostReset ();
+    LoadDirectory (Root, "");
+    if (HostFindFile ("etc/table-loader") == NULL) {
+      fprintf (stderr, "%s: no etc/table-loader\n", Root);
+      return 2;
+    }
+
+    Start    = GetPerformanceCounter ();
+    Status   = InstallQemuFwCfgTables (&gHostAcpiTable);
+    Elapsed += GetPerformanceCounter () - Start;
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    for (UINTN Type = 0; Type < LoaderStatMax; ++Type) {
+      Totals[Type].Ticks += mLoaderStats[Type].Ticks;
+    }
+
+    for (UINTN Phase = 0; Phase < LoaderPhaseMax; ++Phase) {
+      PhaseTotals[Phase] += mLoaderPhaseTicks[Phase];
+    }
+  }
+
+  printf (
+    "%s: status=0x%lx tables=%lu fwcfg-bytes=%lu pool-allocs=%lu pool-peak=%lu "
+    "page-allocs=%lu time=%lluus (mean of %lu)\n",
+    Root,
+    (unsigned long)Status,
+    (unsigned long)HostLiveTables (),
+    (unsigned long)gHost.FwCfgReadBytes,
+    (unsigned long)gHost.PoolAllocations,
+    (unsigned long)gHost.PoolPeakBytes,
+    (unsigned long)gHost.PageAllocations,
+    (unsigned long long)(Elapsed / Iteration / 1000),
+    (unsigned long)Iteration
+    );
+  if (EFI_ERROR (Status)) {
+    return 1;
+  }
+
+  for (UINTN Type = 0; Type < LoaderStatMax; ++Type) {
+    mLoaderStats[Type].Ticks = Totals[Type].Ticks;
+  }
+
+  memcpy (mLoaderPhaseTicks, PhaseTotals, sizeof PhaseTotals);
+  PrintLoaderStats (Iterations);
+  PrintTables ();
+  return 0;
+}
+
+/**
+  Compare LoaderSum8() with CalculateSum8() over unaligned starts, lengths
+  around the word and batch boundaries, and all-0xFF data, which is the worst
+  case for the lane carries.
+**/
+STATIC
+BOOLEAN
+CheckSum8 (
+  VOID
+  )
+{
+  STATIC CONST UINTN  Lengths[] = { 0, 1, 7, 8, 9, 63, 64, 65, 1023, 1024, 1025, 4095, 65537, SIZE_1MB - 16 };
+  UINT8               *Buffer;
+  UINTN               Offset;
+  UINTN               Index;
+  UINTN               Fill;
+  UINTN               Checked;
+  BOOLEAN             Ok;
+
+  Buffer = malloc (SIZE_1MB);
+  ASSERT (Buffer != NULL);
+
+  Ok      = TRUE;
+  Checked = 0;
+  for (Fill = 0; Fill < 2; ++Fill) {
+    for (Index = 0; Index < SIZE_1MB; ++Index) {
+      Buffer[Index] = (Fill == 0) ? (UINT8)(Index * 131 + (Index >> 9)) : 0xFF;
+    }
+
+    for (Offset = 0; Offset < 16; ++Offset) {
+      for (Index = 0; Index < ARRAY_SIZE (Lengths); ++Index) {
+        ++Checked;
+        if (LoaderSum8 (Buffer + Offset, Lengths[Index]) != CalculateSum8 (Buffer + Offset, Lengths[Index])) {
+          printf ("  sum8: mismatch at offset %lu, length %lu, fill %lu\n", (unsigned long)Offset, (unsigned long)Lengths[Index], (unsigned long)Fill);
+          Ok = FALSE;
+        }
+      }
+    }
+  }
+
+  free (Buffer);
+  printf ("%-16s checked=%lu %s\n", "sum8", (unsigned long)Checked, Ok ? "PASS" : "FAIL");
+  return Ok;
+}
+
+//
+// Keeps the benchmarked results alive.
+//
+STATIC volatile UINTN  mBenchSink;
+
+STATIC
+int
+BenchKeyCompare (
+  const void  *First,
+  const void  *Second
+  )
+{
+  return AsciiStrCmp (First, Second);
+}
+
+STATIC
+VOID
+BenchKeyFree (
+  VOID  *Key
+  )
+{
+}
+
+/**
+  Time resolving Refs to blob indices, with the BLOB_INDEX of the loader, and
+  with the ORDERED_COLLECTION tracker that it replaced. The tracker was a
+  red-black tree (BaseOrderedCollectionRedBlackTreeLib) comparing names with
+  AsciiStrCmp() at each level; glibc's tsearch() is a red-black tree as well,
+  and is timed with the same comparison.
+**/
+STATIC
+VOID
+BenchLookups (
+  IN CONST CHAR8  *Label,
+  IN BLOB         *Blobs,
+  IN UINTN        BlobCount,
+  IN CONST UINT8  **Refs,
+  IN UINTN        RefCount,
+  IN UINTN        Rounds
+  )
+{
+  BLOB_INDEX  Index;
+  VOID        *Tree;
+  UINT32      BlobIndex;
+  UINT64      Start;
+  UINT64      IndexTicks;
+  UINT64      TreeTicks;
+  UINTN       Round;
+  UINTN       Ref;
+
+  Tree = NULL;
+  BlobIndexInit (&Index, Blobs, BlobCount);
+  for (Ref = 0; Ref < BlobCount; ++Ref) {
+    BlobIndexInsert (&Index, Ref);
+    tsearch (Blobs[Ref].File, &Tree, BenchKeyCompare);
+  }
+
+  Start = GetPerformanceCounter ();
+  for (Round = 0; Round < Rounds; ++Round) {
+    for (Ref = 0; Ref < RefCount; ++Ref) {
+      BlobIndexFind (&Index, Refs[Ref], &BlobIndex);
+      mBenchSink += BlobIndex;
+    }
+  }
+
+  IndexTicks = GetPerformanceCounter () - Start;
+
+  Start = GetPerformanceCounter ();
+  for (Round = 0; Round < Rounds; ++Round) {
+    for (Ref = 0; Ref < RefCount; ++Ref) {
+      mBenchSink += (UINTN)*(VOID **)tfind (Refs[Ref], &Tree, BenchKeyCompare);
+    }
+  }
+
+  TreeTicks = GetPerformanceCounter () - Start;
+
+  printf ("bench: lookups, %s (%lu blobs, %lu lookups)\n", Label, (unsigned long)BlobCount, (unsigned long)RefCount);
+  printf ("  %-20s %8.1f ns/lookup\n", "BLOB_INDEX", (double)IndexTicks / Rounds / RefCount);
+  printf ("  %-20s %8.1f ns/lookup\n", "red-black tree", (double)TreeTicks / Rounds / RefCount);
+
+  tdestroy (Tree, BenchKeyFree);
+  BlobIndexUninit (&Index);
+}
+
+/**
+  Time LoaderSum8() and CalculateSum8(), the bytewise sum it replaced, over
+  the given ranges.
+**/
+STATIC
+VOID
+BenchSums (
+  IN CONST CHAR8  *Label,
+  IN CONST UINT8  *Base,
+  IN CONST UINTN  *Ranges,
+  IN UINTN        RangeCount,
+  IN UINTN        Rounds
+  )
+{
+  UINT64  Start;
+  UINT64  WordTicks;
+  UINT64  ByteTicks;
+  UINTN   Bytes;
+  UINTN   Round;
+  UINTN   Range;
+
+  Bytes = 0;
+  for (Range = 0; Range < RangeCount; ++Range) {
+    Bytes += Ranges[2 * Range + 1];
+  }
+
+  Start = GetPerformanceCounter ();
+  for (Round = 0; Round < Rounds; ++Round) {
+    for (Range = 0; Range < RangeCount; ++Range) {
+      mBenchSink += LoaderSum8 (Base + Ranges[2 * Range], Ranges[2 * Range + 1]);
+    }
+  }
+
+  WordTicks = GetPerformanceCounter () - Start;
+
+  Start = GetPerformanceCounter ();
+  for (Round = 0; Round < Rounds; ++Round) {
+    for (Range = 0; Range < RangeCount; ++Range) {
+      mBenchSink += CalculateSum8 (Base + Ranges[2 * Range], Ranges[2 * Range + 1]);
+    }
+  }
+
+  ByteTicks = GetPerformanceCounter () - Start;
+
+  printf (
+    "bench: checksums, %s (%lu range%s, %lu bytes)\n",
+    Label,
+    (unsigned long)RangeCount,
+    (RangeCount == 1) ? "" : "s",
+    (unsigned long)Bytes
+    );
+  printf ("  %-20s %10.1f us %8.0f MB/s\n", "LoaderSum8", WordTicks / 1e3 / Rounds, (double)Bytes * Rounds * 1e3 / WordTicks);
+  printf ("  %-20s %10.1f us %8.0f MB/s\n", "bytewise", ByteTicks / 1e3 / Rounds, (double)Bytes * Rounds * 1e3 / ByteTicks);
+}
+
+/**
+  Run the benchmarks on the script and tables of the many-700 scenario, on a
+  synthetic script with thousands of blobs, and on a 512 KiB table.
+**/
+STATIC
+INT32
+Bench (
+  IN UINTN  Rounds
+  )
+{
+  STATIC CONST SCENARIO  Scenario = { "many-700", 700, FaultNone, SCENARIO_S3, EFI_SUCCESS };
+  STATIC BLOB            Blobs[4096];
+  STATIC CONST UINT8     *Refs[4 * ARRAY_SIZE (Blobs)];
+  STATIC UINTN           Ranges[2 * ARRAY_SIZE (mScript)];
+  QEMU_LOADER_ENTRY      *Entry;
+  UINTN                  BlobCount;
+  UINTN                  RefCount;
+  UINTN                  RangeCount;
+  UINTN                  Index;
+
+  HostReset ();
+  BuildConfiguration (&Scenario);
+
+  //
+  // Every file name that the script resolves to a blob, in script order.
+  //
+  BlobCount  = 0;
+  RefCount   = 0;
+  RangeCount = 0;
+  for (Index = 0; Index < mScriptLength; ++Index) {
+    Entry = &mScript[Index];
+    switch (Entry->Type) {
+      case QemuLoaderCmdAllocate:
+        memcpy (Blobs[BlobCount++].File, Entry->Command.Allocate.File, QEMU_LOADER_FNAME_SIZE);
+        break;
+      case QemuLoaderCmdAddPointer:
+        Refs[RefCount++] = Entry->Command.AddPointer.PointerFile;
+        Refs[RefCount++] = Entry->Command.AddPointer.PointeeFile;
+        break;
+      case QemuLoaderCmdAddChecksum:
+        Refs[RefCount++] = Entry->Command.AddChecksum.File;
+        if (strcmp ((CHAR8 *)Entry->Command.AddChecksum.File, "etc/acpi/tables") == 0) {
+          Ranges[2 * RangeCount]     = Entry->Command.AddChecksum.Start;
+          Ranges[2 * RangeCount + 1] = Entry->Command.AddChecksum.Length;
+          ++RangeCount;
+        }
+
+        break;
+      case QemuLoaderCmdWritePointer:
+        Refs[RefCount++] = Entry->Command.WritePointer.PointeeFile;
+        break;
+    }
+  }
+
+  BenchLookups ("many-700", Blobs, BlobCount, Refs, RefCount, Rounds);
+  BenchSums ("many-700", mTables, Ranges, RangeCount, Rounds);
+
+  //
+  // Thousands of blobs under a shared "etc/acpi/" prefix, each named by four
+  // commands, in a scattered order.
+  //
+  BlobCount = ARRAY_SIZE (Blobs);
+  for (Index = 0; Index < BlobCount; ++Index) {
+    snprintf ((CHAR8 *)Blobs[Index].File, QEMU_LOADER_FNAME_SIZE, "etc/acpi/blob-%04lu", (unsigned long)Index);
+  }
+
+  RefCount = ARRAY_SIZE (Refs);
+  for (Index = 0; Index < RefCount; ++Index) {
+    Refs[Index] = Blobs[(Index * 2654435761u) % BlobCount].File;
+  }
+
+  BenchLookups ("synthetic", Blobs, BlobCount, Refs, RefCount, (Rounds + 15) / 16);
+
+  //
+  // One DSDT-sized range, as on guests with many devices.
+  //
+  Ranges[0] = 0;
+  Ranges[1] = SIZE_512KB;
+  BenchSums ("512 KiB table", mTables, Ranges, 1, (Rounds + 15) / 16);
+
+  HostReset ();
+  return 0;
+}
+
+int
+main (
+  int   Argc,
+  char  **Argv
+  )
+{
+  UINTN    Index;
+  INT32    Arg;
+  BOOLEAN  Selected;
+  BOOLEAN  Ok;
+
+  for (Arg = 1; Arg < Argc && strcmp (Argv[Arg], "-v") == 0; ++Arg) {
+    ++gHostVerbosity;
+  }
+
+  if ((Arg < Argc) && (strcmp (Argv[Arg], "--replay") == 0)) {
+    if (Arg + 1 >= Argc) {
+      fprintf (stderr, "usage: %s [-v] --replay DIR [ITERATIONS]\n", Argv[0]);
+      return 2;
+    }
+
+    return Replay (Argv[Arg + 1], (Arg + 2 < Argc) ? strtoul (Argv[Arg + 2], NULL, 0) : 1);
+  }
+
+  if ((Arg < Argc) && (strcmp (Argv[Arg], "--bench") == 0)) {
+    return Bench ((Arg + 1 < Argc) ? strtoul (Argv[Arg + 1], NULL, 0) : 1000);
+  }
+
+  Selected = (Arg == Argc);
+  for (INT32 Name = Arg; Name < Argc; ++Name) {
+    Selected |= (strcmp (Argv[Name], "sum8") == 0);
+  }
+
+  Ok = Selected ? CheckSum8 () : TRUE;
+  for (Index = 0; Index < ARRAY_SIZE (mScenarios); ++Index) {
+    Selected = (Arg == Argc);
+    for (INT32 Name = Arg; Name < Argc; ++Name) {
+      Selected |= (strcmp (Argv[Name], mScenarios[Index].Name) == 0);
+    }
+
+    if (Selected) {
+      Ok &= RunScenario (&mScenarios[Index]);
+    }
+  }
+
+  HostReset ();
+  printf ("%s\n", Ok ? "ALL PASS" : "SOME FAILED");
+  return Ok ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+/** @file
+  Stand-in for the EDK2 base types, status codes and macros that
+  QemuFwCfgAcpi.c relies on, so that it builds as a Linux host program.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_BASE_H_
+#define HOST_BASE_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t    UINT8;
+typedef uint16_t   UINT16;
+typedef uint32_t   UINT32;
+typedef uint64_t   UINT64;
+typedef int8_t     INT8;
+typedef int16_t    INT16;
+typedef int32_t    INT32;
+typedef int64_t    INT64;
+typedef uintptr_t  UINTN;
+typedef intptr_t   INTN;
+typedef uint8_t    BOOLEAN;
+typedef char       CHAR8;
+typedef uint16_t   CHAR16;
+typedef void       VOID;
+
+typedef UINTN          RETURN_STATUS;
+typedef RETURN_STATUS  EFI_STATUS;
+typedef UINT64         EFI_PHYSICAL_ADDRESS;
+typedef VOID           *EFI_HANDLE;
+typedef VOID           *EFI_EVENT;
+
+typedef struct {
+  UINT32    Data1;
+  UINT16    Data2;
+  UINT16    Data3;
+  UINT8     Data4[8];
+} EFI_GUID;
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST   const
+#define STATIC  static
+#define EFIAPI
+
+#define TRUE   ((BOOLEAN)1)
+#define FALSE  ((BOOLEAN)0)
+
+#define MAX_BIT              ((UINTN)1 << (sizeof (UINTN) * 8 - 1))
+#define ENCODE_ERROR(Code)   (MAX_BIT | (Code))
+#define RETURN_ERROR(Status) (((INTN)(RETURN_STATUS)(Status)) < 0)
+#define EFI_ERROR(Status)    RETURN_ERROR (Status)
+
+#define RETURN_SUCCESS          0
+#define RETURN_UNSUPPORTED      ENCODE_ERROR (3)
+#define RETURN_NOT_FOUND        ENCODE_ERROR (14)
+#define RETURN_ALREADY_STARTED  ENCODE_ERROR (20)
+
+#define EFI_SUCCESS            0
+#define EFI_INVALID_PARAMETER  ENCODE_ERROR (2)
+#define EFI_UNSUPPORTED        ENCODE_ERROR (3)
+#define EFI_BAD_BUFFER_SIZE    ENCODE_ERROR (4)
+#define EFI_BUFFER_TOO_SMALL   ENCODE_ERROR (5)
+#define EFI_NOT_READY          ENCODE_ERROR (6)
+#define EFI_OUT_OF_RESOURCES   ENCODE_ERROR (9)
+#define EFI_NOT_FOUND          ENCODE_ERROR (14)
+#define EFI_NOT_STARTED        ENCODE_ERROR (19)
+#define EFI_ALREADY_STARTED    ENCODE_ERROR (20)
+#define EFI_PROTOCOL_ERROR     ENCODE_ERROR (34)
+
+#define MAX_UINT8    0xFF
+#define MAX_UINT16   0xFFFF
+#define MAX_UINT32   0xFFFFFFFFU
+#define MAX_UINT64   0xFFFFFFFFFFFFFFFFULL
+#define MAX_INT32    0x7FFFFFFF
+#define MAX_UINTN    ((UINTN)-1)
+#define MAX_ADDRESS  MAX_UINTN
+
+#define SIZE_4KB    0x00001000
+#define SIZE_64KB   0x00010000
+#define SIZE_128KB  0x00020000
+#define SIZE_256KB  0x00040000
+#define SIZE_512KB  0x00080000
+#define SIZE_1MB    0x00100000
+#define BASE_4GB    0x100000000ULL
+#define SIZE_4GB    0x100000000ULL
+
+#define BIT0   0x00000001
+#define BIT1   0x00000002
+#define BIT2   0x00000004
+#define BIT3   0x00000008
+#define BIT4   0x00000010
+#define BIT5   0x00000020
+#define BIT6   0x00000040
+#define BIT12  0x00001000
+#define BIT20  0x00100000
+#define BIT28  0x10000000
+
+#define EFI_PAGE_SIZE   0x1000
+#define EFI_PAGE_MASK   0xFFF
+#define EFI_PAGE_SHIFT  12
+#define EFI_SIZE_TO_PAGES(Size) \
+  (((Size) >> EFI_PAGE_SHIFT) + (((Size) & EFI_PAGE_MASK) ? 1 : 0))
+#define EFI_PAGES_TO_SIZE(Pages)  ((Pages) << EFI_PAGE_SHIFT)
+
+#define ALIGN_VALUE(Value, Alignment) \
+  ((Value) + (((Alignment) - (Value)) & ((Alignment) - 1)))
+#define ALIGN_POINTER(Pointer, Alignment) \
+  ((VOID *)(ALIGN_VALUE ((UINTN)(Pointer), (Alignment))))
+#define ARRAY_SIZE(Array)           (sizeof (Array) / sizeof ((Array)[0]))
+#define OFFSET_OF(TYPE, Field)      offsetof (TYPE, Field)
+
+#define SIGNATURE_16(A, B)  ((A) | ((B) << 8))
+#define SIGNATURE_32(A, B, C, D) \
+  (SIGNATURE_16 (A, B) | (SIGNATURE_16 (C, D) << 16))
+#define SIGNATURE_64(A, B, C, D, E, F, G, H) \
+  (SIGNATURE_32 (A, B, C, D) | ((UINT64)(SIGNATURE_32 (E, F, G, H)) << 32))
+
+//
+// DebugLib. DEBUG() goes to stderr, filtered by the harness verbosity.
+//
+#define DEBUG_WARN     0x00000002
+#define DEBUG_INFO     0x00000040
+#define DEBUG_VERBOSE  0x00400000
+#define DEBUG_ERROR    0x80000000
+
+VOID
+HostDebugPrint (
+  IN UINTN        ErrorLevel,
+  IN CONST CHAR8  *Format,
+  ...
+  );
+
+#define DEBUG(Expression)             HostDebugPrint Expression
+#define ASSERT(Expression)            assert (Expression)
+#define ASSERT_EFI_ERROR(Status)      assert (!EFI_ERROR (Status))
+#define ASSERT_RETURN_ERROR(Status)   assert (!RETURN_ERROR (Status))
+#define DEBUG_CODE_BEGIN()            do {
+#define DEBUG_CODE_END()              } while (FALSE)
+
+//
+// The subset of the boot services table that the loader calls.
+//
+typedef enum {
+  AllocateAnyPages,
+  AllocateMaxAddress,
+  AllocateAddress
+} EFI_ALLOCATE_TYPE;
+
+typedef enum {
+  EfiReservedMemoryType,
+  EfiLoaderCode,
+  EfiLoaderData,
+  EfiBootServicesCode,
+  EfiBootServicesData,
+  EfiRuntimeServicesCode,
+  EfiRuntimeServicesData,
+  EfiConventionalMemory,
+  EfiUnusableMemory,
+  EfiACPIReclaimMemory,
+  EfiACPIMemoryNVS
+} EFI_MEMORY_TYPE;
+
+typedef enum {
+  EFI_NATIVE_INTERFACE
+} EFI_INTERFACE_TYPE;
+
+typedef struct {
+  EFI_STATUS (EFIAPI *AllocatePages)(
+    EFI_ALLOCATE_TYPE, EFI_MEMORY_TYPE, UINTN, EFI_PHYSICAL_ADDRESS *);
+  EFI_STATUS (EFIAPI *FreePages)(EFI_PHYSICAL_ADDRESS, UINTN);
+  EFI_STATUS (EFIAPI *InstallProtocolInterface)(
+    EFI_HANDLE *, EFI_GUID *, EFI_INTERFACE_TYPE, VOID *);
+  EFI_STATUS (EFIAPI *UninstallProtocolInterface)(
+    EFI_HANDLE, EFI_GUID *, VOID *);
+} EFI_BOOT_SERVICES;
+
+extern EFI_BOOT_SERVICES  *gBS;
+extern EFI_GUID           gQemuAcpiTableNotifyProtocolGuid;
+
+#endif
@@ -0,0 +1,45 @@
+/** @file
+  Host stand-in for <IndustryStandard/Acpi.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_ACPI_H_
+#define HOST_ACPI_H_
+
+#include <HostBase.h>
+
+#pragma pack (1)
+typedef struct {
+  UINT32    Signature;
+  UINT32    Length;
+  UINT8     Revision;
+  UINT8     Checksum;
+  UINT8     OemId[6];
+  UINT64    OemTableId;
+  UINT32    OemRevision;
+  UINT32    CreatorId;
+  UINT32    CreatorRevision;
+} EFI_ACPI_DESCRIPTION_HEADER;
+
+typedef struct {
+  UINT32    Signature;
+  UINT32    Length;
+  UINT32    HardwareSignature;
+  UINT32    FirmwareWakingVector;
+  UINT32    GlobalLock;
+  UINT32    Flags;
+  UINT8     Reserved[40];
+} EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE;
+#pragma pack ()
+
+#define EFI_ACPI_1_0_FIRMWARE_ACPI_CONTROL_STRUCTURE_SIGNATURE \
+  SIGNATURE_32 ('F', 'A', 'C', 'S')
+#define EFI_ACPI_1_0_ROOT_SYSTEM_DESCRIPTION_TABLE_SIGNATURE \
+  SIGNATURE_32 ('R', 'S', 'D', 'T')
+#define EFI_ACPI_2_0_EXTENDED_SYSTEM_DESCRIPTION_TABLE_SIGNATURE \
+  SIGNATURE_32 ('X', 'S', 'D', 'T')
+#define EFI_ACPI_2_0_SECONDARY_SYSTEM_DESCRIPTION_TABLE_SIGNATURE \
+  SIGNATURE_32 ('S', 'S', 'D', 'T')
+
+#endif
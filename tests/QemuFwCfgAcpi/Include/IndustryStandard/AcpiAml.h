@@ -0,0 +1,42 @@
+/** @file
+  Host stand-in for <IndustryStandard/AcpiAml.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_ACPI_AML_H_
+#define HOST_ACPI_AML_H_
+
+#include <HostBase.h>
+
+#define AML_ZERO_OP              0x00
+#define AML_ONE_OP               0x01
+#define AML_NAME_OP              0x08
+#define AML_BYTE_PREFIX          0x0A
+#define AML_WORD_PREFIX          0x0B
+#define AML_DWORD_PREFIX         0x0C
+#define AML_QWORD_PREFIX         0x0E
+#define AML_SCOPE_OP             0x10
+#define AML_BUFFER_OP            0x11
+#define AML_METHOD_OP            0x14
+#define AML_DUAL_NAME_PREFIX     0x2E
+#define AML_MULTI_NAME_PREFIX    0x2F
+#define AML_EXT_OP               0x5B
+#define AML_EXT_REGION_OP        0x80
+#define AML_EXT_FIELD_OP         0x81
+#define AML_ROOT_CHAR            0x5C
+#define AML_PARENT_PREFIX_CHAR   0x5E
+#define AML_LOCAL0               0x60
+#define AML_ARG0                 0x68
+#define AML_ARG1                 0x69
+#define AML_STORE_OP             0x70
+#define AML_ADD_OP               0x72
+#define AML_SUBTRACT_OP          0x74
+#define AML_LNOT_OP              0x92
+#define AML_LGREATER_OP          0x94
+#define AML_LLESS_OP             0x95
+#define AML_MID_OP               0x9E
+#define AML_IF_OP                0xA0
+#define AML_RETURN_OP            0xA4
+
+#endif
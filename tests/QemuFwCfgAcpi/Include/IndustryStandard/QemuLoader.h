@@ -0,0 +1,67 @@
+/** @file
+  Host stand-in for <IndustryStandard/QemuLoader.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_QEMU_LOADER_H_
+#define HOST_QEMU_LOADER_H_
+
+#include <HostBase.h>
+
+#define QEMU_LOADER_FNAME_SIZE  56
+
+typedef enum {
+  QemuLoaderCmdAllocate = 1,
+  QemuLoaderCmdAddPointer,
+  QemuLoaderCmdAddChecksum,
+  QemuLoaderCmdWritePointer,
+} QEMU_LOADER_COMMAND_TYPE;
+
+typedef enum {
+  QemuLoaderAllocHigh = 1,
+  QemuLoaderAllocFSeg
+} QEMU_LOADER_ALLOC_ZONE;
+
+#pragma pack (1)
+typedef struct {
+  UINT8     File[QEMU_LOADER_FNAME_SIZE];
+  UINT32    Alignment;
+  UINT8     Zone;
+} QEMU_LOADER_ALLOCATE;
+
+typedef struct {
+  UINT8     PointerFile[QEMU_LOADER_FNAME_SIZE];
+  UINT8     PointeeFile[QEMU_LOADER_FNAME_SIZE];
+  UINT32    PointerOffset;
+  UINT8     PointerSize;
+} QEMU_LOADER_ADD_POINTER;
+
+typedef struct {
+  UINT8     File[QEMU_LOADER_FNAME_SIZE];
+  UINT32    ResultOffset;
+  UINT32    Start;
+  UINT32    Length;
+} QEMU_LOADER_ADD_CHECKSUM;
+
+typedef struct {
+  UINT8     PointerFile[QEMU_LOADER_FNAME_SIZE];
+  UINT8     PointeeFile[QEMU_LOADER_FNAME_SIZE];
+  UINT32    PointerOffset;
+  UINT32    PointeeOffset;
+  UINT8     PointerSize;
+} QEMU_LOADER_WRITE_POINTER;
+
+typedef struct {
+  UINT32    Type;
+  union {
+    QEMU_LOADER_ALLOCATE         Allocate;
+    QEMU_LOADER_ADD_POINTER      AddPointer;
+    QEMU_LOADER_ADD_CHECKSUM     AddChecksum;
+    QEMU_LOADER_WRITE_POINTER    WritePointer;
+    UINT8                        Padding[124];
+  } Command;
+} QEMU_LOADER_ENTRY;
+#pragma pack ()
+
+#endif
@@ -0,0 +1,17 @@
+/** @file
+  Host stand-in for <IndustryStandard/UefiTcgPlatform.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_UEFI_TCG_PLATFORM_H_
+#define HOST_UEFI_TCG_PLATFORM_H_
+
+#include <HostBase.h>
+
+#define EV_PLATFORM_CONFIG_FLAGS  ((UINT32)0x0000000A)
+
+#define EV_POSTCODE_INFO_ACPI_DATA  "ACPI DATA"
+#define ACPI_DATA_LEN               (sizeof (EV_POSTCODE_INFO_ACPI_DATA) - 1)
+
+#endif
@@ -0,0 +1,35 @@
+/** @file
+  Host stand-in for <Library/BaseLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_BASE_LIB_H_
+#define HOST_BASE_LIB_H_
+
+#include <HostBase.h>
+
+#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+
+INTN   EFIAPI AsciiStrCmp (CONST CHAR8 *FirstString, CONST CHAR8 *SecondString);
+UINTN  EFIAPI AsciiStrLen (CONST CHAR8 *String);
+UINTN  EFIAPI AsciiStrnLenS (CONST CHAR8 *String, UINTN MaxSize);
+UINT64 EFIAPI LShiftU64 (UINT64 Operand, UINTN Count);
+UINT64 EFIAPI RShiftU64 (UINT64 Operand, UINTN Count);
+UINT64 EFIAPI MultU64x32 (UINT64 Multiplicand, UINT32 Multiplier);
+UINT64 EFIAPI MultU64x64 (UINT64 Multiplicand, UINT64 Multiplier);
+UINT64 EFIAPI DivU64x32 (UINT64 Dividend, UINT32 Divisor);
+UINT64 EFIAPI DivU64x64Remainder (UINT64 Dividend, UINT64 Divisor, UINT64 *Remainder);
+INTN   EFIAPI HighBitSet64 (UINT64 Operand);
+UINT32 EFIAPI GetPowerOfTwo32 (UINT32 Operand);
+UINT64 EFIAPI GetPowerOfTwo64 (UINT64 Operand);
+UINT8  EFIAPI CalculateSum8 (CONST UINT8 *Buffer, UINTN Length);
+UINT8  EFIAPI CalculateCheckSum8 (CONST UINT8 *Buffer, UINTN Length);
+UINT32 EFIAPI CalculateCrc32 (VOID *Buffer, UINTN Length);
+UINT32 EFIAPI ReadUnaligned32 (CONST UINT32 *Buffer);
+UINT64 EFIAPI ReadUnaligned64 (CONST UINT64 *Buffer);
+UINT32 EFIAPI WriteUnaligned32 (UINT32 *Buffer, UINT32 Value);
+UINT64 EFIAPI WriteUnaligned64 (UINT64 *Buffer, UINT64 Value);
+
+#endif
@@ -0,0 +1,18 @@
+/** @file
+  Host stand-in for <Library/BaseMemoryLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_BASE_MEMORY_LIB_H_
+#define HOST_BASE_MEMORY_LIB_H_
+
+#include <HostBase.h>
+
+VOID *  EFIAPI CopyMem (VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+VOID *  EFIAPI SetMem (VOID *Buffer, UINTN Length, UINT8 Value);
+VOID *  EFIAPI ZeroMem (VOID *Buffer, UINTN Length);
+INTN    EFIAPI CompareMem (CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length);
+BOOLEAN EFIAPI CompareGuid (CONST EFI_GUID *Guid1, CONST EFI_GUID *Guid2);
+
+#endif
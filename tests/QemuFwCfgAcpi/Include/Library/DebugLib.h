@@ -0,0 +1,12 @@
+/** @file
+  Host stand-in for <Library/DebugLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_DEBUG_LIB_H_
+#define HOST_DEBUG_LIB_H_
+
+#include <HostBase.h>
+
+#endif
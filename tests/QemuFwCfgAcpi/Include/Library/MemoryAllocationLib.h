@@ -0,0 +1,17 @@
+/** @file
+  Host stand-in for <Library/MemoryAllocationLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_MEMORY_ALLOCATION_LIB_H_
+#define HOST_MEMORY_ALLOCATION_LIB_H_
+
+#include <HostBase.h>
+
+VOID * EFIAPI AllocatePool (UINTN AllocationSize);
+VOID * EFIAPI AllocateZeroPool (UINTN AllocationSize);
+VOID * EFIAPI ReallocatePool (UINTN OldSize, UINTN NewSize, VOID *OldBuffer);
+VOID   EFIAPI FreePool (VOID *Buffer);
+
+#endif
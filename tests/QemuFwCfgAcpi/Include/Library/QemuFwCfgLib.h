@@ -0,0 +1,21 @@
+/** @file
+  Host stand-in for <Library/QemuFwCfgLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_QEMU_FW_CFG_LIB_H_
+#define HOST_QEMU_FW_CFG_LIB_H_
+
+#include <HostBase.h>
+
+typedef UINTN  FIRMWARE_CONFIG_ITEM;
+
+BOOLEAN       EFIAPI QemuFwCfgIsAvailable (VOID);
+VOID          EFIAPI QemuFwCfgSelectItem (FIRMWARE_CONFIG_ITEM QemuFwCfgItem);
+VOID          EFIAPI QemuFwCfgReadBytes (UINTN Size, VOID *Buffer);
+VOID          EFIAPI QemuFwCfgWriteBytes (UINTN Size, VOID *Buffer);
+VOID          EFIAPI QemuFwCfgSkipBytes (UINTN Size);
+RETURN_STATUS EFIAPI QemuFwCfgFindFile (CONST CHAR8 *Name, FIRMWARE_CONFIG_ITEM *Item, UINTN *Size);
+
+#endif
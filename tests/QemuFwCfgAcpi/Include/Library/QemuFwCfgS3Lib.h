@@ -0,0 +1,14 @@
+/** @file
+  Host stand-in for <Library/QemuFwCfgS3Lib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_QEMU_FW_CFG_S3_LIB_H_
+#define HOST_QEMU_FW_CFG_S3_LIB_H_
+
+#include <HostBase.h>
+
+BOOLEAN EFIAPI QemuFwCfgS3Enabled (VOID);
+
+#endif
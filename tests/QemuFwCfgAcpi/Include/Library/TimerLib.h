@@ -0,0 +1,15 @@
+/** @file
+  Host stand-in for <Library/TimerLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_TIMER_LIB_H_
+#define HOST_TIMER_LIB_H_
+
+#include <HostBase.h>
+
+UINT64 EFIAPI GetPerformanceCounter (VOID);
+UINT64 EFIAPI GetTimeInNanoSecond (UINT64 Ticks);
+
+#endif
@@ -0,0 +1,23 @@
+/** @file
+  Host stand-in for <Library/TpmMeasurementLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_TPM_MEASUREMENT_LIB_H_
+#define HOST_TPM_MEASUREMENT_LIB_H_
+
+#include <HostBase.h>
+
+EFI_STATUS
+EFIAPI
+TpmMeasureAndLogData (
+  IN UINT32  PcrIndex,
+  IN UINT32  EventType,
+  IN VOID    *EventLog,
+  IN UINT32  LogLen,
+  IN VOID    *HashData,
+  IN UINT64  HashDataLen
+  );
+
+#endif
@@ -0,0 +1,12 @@
+/** @file
+  Host stand-in for <Library/UefiBootServicesTableLib.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_UEFI_BOOT_SERVICES_TABLE_LIB_H_
+#define HOST_UEFI_BOOT_SERVICES_TABLE_LIB_H_
+
+#include <HostBase.h>
+
+#endif
@@ -0,0 +1,20 @@
+/** @file
+  Host stand-in for <Protocol/AcpiTable.h>.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef HOST_ACPI_TABLE_H_
+#define HOST_ACPI_TABLE_H_
+
+#include <HostBase.h>
+
+typedef struct _EFI_ACPI_TABLE_PROTOCOL EFI_ACPI_TABLE_PROTOCOL;
+
+struct _EFI_ACPI_TABLE_PROTOCOL {
+  EFI_STATUS (EFIAPI *InstallAcpiTable)(
+    EFI_ACPI_TABLE_PROTOCOL *, VOID *, UINTN, UINTN *);
+  EFI_STATUS (EFIAPI *UninstallAcpiTable)(EFI_ACPI_TABLE_PROTOCOL *, UINTN);
+};
+
+#endif
@@ -0,0 +1,11 @@
+/** @file
+  A small stand-in VBIOS image for the harness. The real vrom.h is generated
+  from the passed-through GPU's ROM with "xxd -i".
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+STATIC UINT8  VROM_BIN[] = {
+  0x55, 0xAA, 0x40, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08
+};
+STATIC UINT32  VROM_BIN_LEN = sizeof VROM_BIN;
@@ -0,0 +1,851 @@
+/** @file
+  Simulated platform for the QemuFwCfgAcpi.c host harness. See Stubs.h.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#define _GNU_SOURCE
+
+#include <malloc.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <Library/AcpiPlatformLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/QemuFwCfgLib.h>
+#include <Library/QemuFwCfgS3Lib.h>
+#include <Library/TimerLib.h>
+#include <Library/TpmMeasurementLib.h>
+
+#include "Stubs.h"
+
+HOST_STATE        gHost;
+HOST_FILE         gHostFiles[HOST_MAX_FILES];
+UINTN             gHostFileCount;
+HOST_MEASUREMENT  gHostMeasurements[HOST_MAX_MEASUREMENTS];
+UINTN             gHostMeasurementCount;
+HOST_S3_WRITE     gHostS3Writes[HOST_MAX_S3_WRITES];
+UINTN             gHostS3WriteCount;
+HOST_TABLE        gHostTables[HOST_MAX_TABLES];
+UINTN             gHostTableCount;
+UINTN             gHostVerbosity;
+
+EFI_GUID  gQemuAcpiTableNotifyProtocolGuid;
+
+//
+// DebugLib: translate the EDK2 format specifiers that the loader uses (%a,
+// %r, %Lx, %Lu, %Ld) to printf ones.
+//
+VOID
+HostDebugPrint (
+  IN UINTN        ErrorLevel,
+  IN CONST CHAR8  *Format,
+  ...
+  )
+{
+  CHAR8        Converted[1024];
+  UINTN        Length;
+  CONST CHAR8  *Char;
+  va_list      Marker;
+
+  if (((ErrorLevel == DEBUG_INFO) && (gHostVerbosity < 1)) ||
+      ((ErrorLevel == DEBUG_VERBOSE) && (gHostVerbosity < 2)))
+  {
+    return;
+  }
+
+  Length = 0;
+  for (Char = Format; *Char != '\0' && Length < sizeof Converted - 4; ++Char) {
+    Converted[Length++] = *Char;
+    if (*Char != '%') {
+      continue;
+    }
+
+    ++Char;
+    while (*Char == '-' || *Char == '.' || (*Char >= '0' && *Char <= '9')) {
+      Converted[Length++] = *Char++;
+    }
+
+    switch (*Char) {
+      case 'a':
+        Converted[Length++] = 's';
+        break;
+      case 'r':
+        Converted[Length++] = 'l';
+        Converted[Length++] = 'x';
+        break;
+      case 'L':
+        Converted[Length++] = 'l';
+        Converted[Length++] = 'l';
+        Converted[Length++] = *++Char;
+        break;
+      default:
+        Converted[Length++] = *Char;
+        break;
+    }
+  }
+
+  Converted[Length] = '\0';
+
+  va_start (Marker, Format);
+  fprintf (stderr, "  | ");
+  vfprintf (stderr, Converted, Marker);
+  va_end (Marker);
+}
+
+//
+// BaseLib and BaseMemoryLib.
+//
+INTN EFIAPI
+AsciiStrCmp (CONST CHAR8 *FirstString, CONST CHAR8 *SecondString)
+{
+  return strcmp (FirstString, SecondString);
+}
+
+UINTN EFIAPI
+AsciiStrLen (CONST CHAR8 *String)
+{
+  return strlen (String);
+}
+
+UINTN EFIAPI
+AsciiStrnLenS (CONST CHAR8 *String, UINTN MaxSize)
+{
+  return strnlen (String, MaxSize);
+}
+
+UINT64 EFIAPI
+LShiftU64 (UINT64 Operand, UINTN Count)
+{
+  return Operand << Count;
+}
+
+UINT64 EFIAPI
+RShiftU64 (UINT64 Operand, UINTN Count)
+{
+  return Operand >> Count;
+}
+
+UINT64 EFIAPI
+MultU64x32 (UINT64 Multiplicand, UINT32 Multiplier)
+{
+  return Multiplicand * Multiplier;
+}
+
+UINT64 EFIAPI
+MultU64x64 (UINT64 Multiplicand, UINT64 Multiplier)
+{
+  return Multiplicand * Multiplier;
+}
+
+UINT64 EFIAPI
+DivU64x32 (UINT64 Dividend, UINT32 Divisor)
+{
+  return Dividend / Divisor;
+}
+
+UINT64 EFIAPI
+DivU64x64Remainder (UINT64 Dividend, UINT64 Divisor, UINT64 *Remainder)
+{
+  if (Remainder != NULL) {
+    *Remainder = Dividend % Divisor;
+  }
+
+  return Dividend / Divisor;
+}
+
+INTN EFIAPI
+HighBitSet64 (UINT64 Operand)
+{
+  return (Operand == 0) ? -1 : 63 - __builtin_clzll (Operand);
+}
+
+UINT32 EFIAPI
+GetPowerOfTwo32 (UINT32 Operand)
+{
+  return (Operand == 0) ? 0 : 1U << (31 - __builtin_clz (Operand));
+}
+
+UINT64 EFIAPI
+GetPowerOfTwo64 (UINT64 Operand)
+{
+  return (Operand == 0) ? 0 : 1ULL << (63 - __builtin_clzll (Operand));
+}
+
+UINT8 EFIAPI
+CalculateSum8 (CONST UINT8 *Buffer, UINTN Length)
+{
+  UINT8  Sum;
+
+  for (Sum = 0; Length > 0; --Length) {
+    Sum = (UINT8)(Sum + *Buffer++);
+  }
+
+  return Sum;
+}
+
+UINT8 EFIAPI
+CalculateCheckSum8 (CONST UINT8 *Buffer, UINTN Length)
+{
+  return (UINT8)(0x100 - CalculateSum8 (Buffer, Length));
+}
+
+UINT32 EFIAPI
+CalculateCrc32 (VOID *Buffer, UINTN Length)
+{
+  UINT32  Crc;
+  UINT8   *Byte;
+  UINTN   Bit;
+
+  Crc = MAX_UINT32;
+  for (Byte = Buffer; Length > 0; --Length) {
+    Crc ^= *Byte++;
+    for (Bit = 0; Bit < 8; ++Bit) {
+      Crc = (Crc >> 1) ^ (0xEDB88320 & (0U - (Crc & 1)));
+    }
+  }
+
+  return ~Crc;
+}
+
+UINT32 EFIAPI
+ReadUnaligned32 (CONST UINT32 *Buffer)
+{
+  UINT32  Value;
+
+  memcpy (&Value, Buffer, sizeof Value);
+  return Value;
+}
+
+UINT64 EFIAPI
+ReadUnaligned64 (CONST UINT64 *Buffer)
+{
+  UINT64  Value;
+
+  memcpy (&Value, Buffer, sizeof Value);
+  return Value;
+}
+
+UINT32 EFIAPI
+WriteUnaligned32 (UINT32 *Buffer, UINT32 Value)
+{
+  memcpy (Buffer, &Value, sizeof Value);
+  return Value;
+}
+
+UINT64 EFIAPI
+WriteUnaligned64 (UINT64 *Buffer, UINT64 Value)
+{
+  memcpy (Buffer, &Value, sizeof Value);
+  return Value;
+}
+
+VOID * EFIAPI
+CopyMem (VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length)
+{
+  return memmove (DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID * EFIAPI
+SetMem (VOID *Buffer, UINTN Length, UINT8 Value)
+{
+  return memset (Buffer, Value, Length);
+}
+
+VOID * EFIAPI
+ZeroMem (VOID *Buffer, UINTN Length)
+{
+  return memset (Buffer, 0, Length);
+}
+
+INTN EFIAPI
+CompareMem (CONST VOID *DestinationBuffer, CONST VOID *SourceBuffer, UINTN Length)
+{
+  return memcmp (DestinationBuffer, SourceBuffer, Length);
+}
+
+BOOLEAN EFIAPI
+CompareGuid (CONST EFI_GUID *Guid1, CONST EFI_GUID *Guid2)
+{
+  return memcmp (Guid1, Guid2, sizeof *Guid1) == 0;
+}
+
+//
+// TimerLib: the performance counter runs in nanoseconds.
+//
+UINT64 EFIAPI
+GetPerformanceCounter (VOID)
+{
+  struct timespec  Now;
+
+  clock_gettime (CLOCK_MONOTONIC, &Now);
+  return (UINT64)Now.tv_sec * 1000000000ULL + (UINT64)Now.tv_nsec;
+}
+
+UINT64 EFIAPI
+GetTimeInNanoSecond (UINT64 Ticks)
+{
+  return Ticks;
+}
+
+//
+// MemoryAllocationLib: malloc() with outstanding-allocation and peak-byte
+// accounting.
+//
+VOID * EFIAPI
+AllocatePool (UINTN AllocationSize)
+{
+  VOID  *Buffer;
+
+  if ((gHost.FailPoolAfter >= 0) && (gHost.FailPoolAfter-- == 0)) {
+    return NULL;
+  }
+
+  Buffer = malloc ((AllocationSize == 0) ? 1 : AllocationSize);
+  assert (Buffer != NULL);
+
+  gHost.PoolOutstanding++;
+  gHost.PoolAllocations++;
+  gHost.PoolBytes    += malloc_usable_size (Buffer);
+  gHost.PoolPeakBytes = MAX (gHost.PoolPeakBytes, gHost.PoolBytes);
+  return Buffer;
+}
+
+VOID * EFIAPI
+AllocateZeroPool (UINTN AllocationSize)
+{
+  VOID  *Buffer;
+
+  Buffer = AllocatePool (AllocationSize);
+  if (Buffer != NULL) {
+    memset (Buffer, 0, AllocationSize);
+  }
+
+  return Buffer;
+}
+
+VOID * EFIAPI
+ReallocatePool (UINTN OldSize, UINTN NewSize, VOID *OldBuffer)
+{
+  VOID  *NewBuffer;
+
+  NewBuffer = AllocatePool (NewSize);
+  if ((NewBuffer != NULL) && (OldBuffer != NULL)) {
+    memcpy (NewBuffer, OldBuffer, MIN (OldSize, NewSize));
+    FreePool (OldBuffer);
+  }
+
+  return NewBuffer;
+}
+
+VOID EFIAPI
+FreePool (VOID *Buffer)
+{
+  assert (Buffer != NULL);
+  gHost.PoolOutstanding--;
+  gHost.PoolBytes -= malloc_usable_size (Buffer);
+  free (Buffer);
+}
+
+//
+// Boot services. Pages are tracked one by one, so that partial frees are
+// caught, and are filled with a poison pattern, so that the loader has to
+// zero what it relies on. AllocateMaxAddress below 4GB maps with MAP_32BIT;
+// anything else lands wherever mmap() puts it, which is above 4GB on x86_64.
+//
+#define HOST_MAX_PAGES  65536
+
+STATIC struct {
+  EFI_PHYSICAL_ADDRESS    Address;
+  EFI_MEMORY_TYPE         Type;
+} mPages[HOST_MAX_PAGES];
+STATIC UINTN  mPageCount;
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostAllocatePages (
+  IN     EFI_ALLOCATE_TYPE     Type,
+  IN     EFI_MEMORY_TYPE       MemoryType,
+  IN     UINTN                 Pages,
+  IN OUT EFI_PHYSICAL_ADDRESS  *Memory
+  )
+{
+  BOOLEAN  Below4G;
+  UINT8    *Buffer;
+  UINTN    Index;
+
+  gHost.PageAllocations++;
+  if (gHost.FailReservedPages && (MemoryType == EfiReservedMemoryType)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  assert (Pages > 0);
+  Below4G = (Type == AllocateMaxAddress) && (*Memory <= MAX_UINT32);
+  Buffer  = mmap (
+              NULL,
+              EFI_PAGES_TO_SIZE (Pages),
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | (Below4G ? MAP_32BIT : 0),
+              -1,
+              0
+              );
+  if (Buffer == MAP_FAILED) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Type == AllocateMaxAddress) {
+    assert ((UINTN)Buffer + EFI_PAGES_TO_SIZE (Pages) - 1 <= *Memory);
+  }
+
+  memset (Buffer, 0xCC, EFI_PAGES_TO_SIZE (Pages));
+  for (Index = 0; Index < Pages; ++Index) {
+    assert (mPageCount < HOST_MAX_PAGES);
+    mPages[mPageCount].Address = (UINTN)Buffer + EFI_PAGES_TO_SIZE (Index);
+    mPages[mPageCount].Type    = MemoryType;
+    ++mPageCount;
+  }
+
+  *Memory = (UINTN)Buffer;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostFreePages (
+  IN EFI_PHYSICAL_ADDRESS  Memory,
+  IN UINTN                 Pages
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Page;
+  UINTN                 Index;
+
+  assert ((Memory & EFI_PAGE_MASK) == 0);
+  for (Page = Memory; Page < Memory + EFI_PAGES_TO_SIZE (Pages); Page += EFI_PAGE_SIZE) {
+    for (Index = 0; Index < mPageCount; ++Index) {
+      if (mPages[Index].Address == Page) {
+        break;
+      }
+    }
+
+    if (Index == mPageCount) {
+      fprintf (stderr, "FreePages: page 0x%llx is not allocated\n", (unsigned long long)Page);
+      abort ();
+    }
+
+    mPages[Index] = mPages[--mPageCount];
+    munmap ((VOID *)(UINTN)Page, EFI_PAGE_SIZE);
+  }
+
+  return EFI_SUCCESS;
+}
+
+UINTN
+HostPagesOutstanding (
+  IN INTN  Type
+  )
+{
+  UINTN  Count;
+  UINTN  Index;
+
+  Count = 0;
+  for (Index = 0; Index < mPageCount; ++Index) {
+    if ((Type < 0) || (mPages[Index].Type == (EFI_MEMORY_TYPE)Type)) {
+      ++Count;
+    }
+  }
+
+  return Count;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostInstallProtocolInterface (
+  IN OUT EFI_HANDLE          *Handle,
+  IN     EFI_GUID            *Protocol,
+  IN     EFI_INTERFACE_TYPE  InterfaceType,
+  IN     VOID                *Interface
+  )
+{
+  gHost.NotifyInstalled++;
+  *Handle = (EFI_HANDLE)&gHost;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostUninstallProtocolInterface (
+  IN EFI_HANDLE  Handle,
+  IN EFI_GUID    *Protocol,
+  IN VOID        *Interface
+  )
+{
+  gHost.NotifyInstalled--;
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_BOOT_SERVICES  mBootServices = {
+  HostAllocatePages,
+  HostFreePages,
+  HostInstallProtocolInterface,
+  HostUninstallProtocolInterface,
+};
+
+EFI_BOOT_SERVICES  *gBS = &mBootServices;
+
+//
+// QemuFwCfgLib and QemuFwCfgS3Lib, over gHostFiles.
+//
+STATIC HOST_FILE  *mSelected;
+STATIC UINTN      mOffset;
+
+UINTN
+HostAddFile (
+  IN CONST CHAR8  *Name,
+  IN CONST VOID   *Data,
+  IN UINTN        Size
+  )
+{
+  HOST_FILE  *File;
+
+  assert (gHostFileCount < HOST_MAX_FILES);
+  assert (strlen (Name) < QEMU_LOADER_FNAME_SIZE);
+
+  File = &gHostFiles[gHostFileCount];
+  memset (File, 0, sizeof *File);
+  strcpy (File->Name, Name);
+  File->Data = calloc (1, (Size == 0) ? 1 : Size);
+  File->Size = Size;
+  if (Data != NULL) {
+    memcpy (File->Data, Data, Size);
+  }
+
+  return gHostFileCount++;
+}
+
+HOST_FILE *
+HostFindFile (
+  IN CONST CHAR8  *Name
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < gHostFileCount; ++Index) {
+    if (strcmp (gHostFiles[Index].Name, Name) == 0) {
+      return &gHostFiles[Index];
+    }
+  }
+
+  return NULL;
+}
+
+BOOLEAN EFIAPI
+QemuFwCfgIsAvailable (VOID)
+{
+  return TRUE;
+}
+
+RETURN_STATUS EFIAPI
+QemuFwCfgFindFile (CONST CHAR8 *Name, FIRMWARE_CONFIG_ITEM *Item, UINTN *Size)
+{
+  HOST_FILE  *File;
+
+  gHost.FindFileCalls++;
+  File = HostFindFile (Name);
+  if (File == NULL) {
+    return RETURN_NOT_FOUND;
+  }
+
+  File->Lookups++;
+  *Item = HOST_FIRST_FILE_ITEM + (File - gHostFiles);
+  *Size = File->Size;
+  return RETURN_SUCCESS;
+}
+
+VOID EFIAPI
+QemuFwCfgSelectItem (FIRMWARE_CONFIG_ITEM QemuFwCfgItem)
+{
+  assert (QemuFwCfgItem >= HOST_FIRST_FILE_ITEM);
+  assert (QemuFwCfgItem - HOST_FIRST_FILE_ITEM < gHostFileCount);
+
+  gHost.FwCfgSelects++;
+  mSelected = &gHostFiles[QemuFwCfgItem - HOST_FIRST_FILE_ITEM];
+  mSelected->Selects++;
+  mOffset = 0;
+}
+
+VOID EFIAPI
+QemuFwCfgReadBytes (UINTN Size, VOID *Buffer)
+{
+  assert (mSelected != NULL);
+  assert (mOffset + Size <= mSelected->Size);
+
+  memcpy (Buffer, mSelected->Data + mOffset, Size);
+  mOffset              += Size;
+  mSelected->ReadBytes += Size;
+  gHost.FwCfgReadBytes += Size;
+}
+
+VOID EFIAPI
+QemuFwCfgWriteBytes (UINTN Size, VOID *Buffer)
+{
+  assert (mSelected != NULL);
+  assert (mOffset + Size <= mSelected->Size);
+
+  memcpy (mSelected->Data + mOffset, Buffer, Size);
+  mOffset += Size;
+  gHost.FwCfgWrites++;
+}
+
+VOID EFIAPI
+QemuFwCfgSkipBytes (UINTN Size)
+{
+  assert (mSelected != NULL);
+  assert (mOffset + Size <= mSelected->Size);
+  mOffset += Size;
+}
+
+BOOLEAN EFIAPI
+QemuFwCfgS3Enabled (VOID)
+{
+  return gHost.S3Enabled;
+}
+
+//
+// TpmMeasurementLib: record the size and CRC of each measured buffer.
+//
+EFI_STATUS
+EFIAPI
+TpmMeasureAndLogData (
+  IN UINT32  PcrIndex,
+  IN UINT32  EventType,
+  IN VOID    *EventLog,
+  IN UINT32  LogLen,
+  IN VOID    *HashData,
+  IN UINT64  HashDataLen
+  )
+{
+  HOST_MEASUREMENT  *Measurement;
+
+  assert (gHostMeasurementCount < HOST_MAX_MEASUREMENTS);
+  Measurement            = &gHostMeasurements[gHostMeasurementCount++];
+  Measurement->PcrIndex  = PcrIndex;
+  Measurement->EventType = EventType;
+  Measurement->Size      = (UINTN)HashDataLen;
+  Measurement->Crc       = CalculateCrc32 (HashData, (UINTN)HashDataLen);
+  return EFI_SUCCESS;
+}
+
+//
+// The AcpiPlatformLib helpers from the neighbouring source files: PCI
+// decoding is only counted, and the S3 context records the condensed writes
+// so that the harness can replay them.
+//
+VOID
+EnablePciDecoding (
+  OUT ORIGINAL_ATTRIBUTES  **OriginalAttributes,
+  OUT UINTN                *Count
+  )
+{
+  gHost.PciDecodingDepth++;
+  *OriginalAttributes = NULL;
+  *Count              = 0;
+}
+
+VOID
+RestorePciDecoding (
+  IN ORIGINAL_ATTRIBUTES  *OriginalAttributes,
+  IN UINTN                Count
+  )
+{
+  gHost.PciDecodingDepth--;
+}
+
+struct S3_CONTEXT {
+  UINTN            Capacity;
+  UINTN            Used;
+  HOST_S3_WRITE    Writes[];
+};
+
+EFI_STATUS
+AllocateS3Context (
+  OUT S3_CONTEXT  **S3Context,
+  IN  UINTN       WritePointerCount
+  )
+{
+  S3_CONTEXT  *Context;
+
+  if (WritePointerCount == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Context = AllocatePool (sizeof *Context + WritePointerCount * sizeof (HOST_S3_WRITE));
+  if (Context == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Context->Capacity       = WritePointerCount;
+  Context->Used           = 0;
+  gHost.S3ContextCapacity = WritePointerCount;
+  *S3Context              = Context;
+  return EFI_SUCCESS;
+}
+
+VOID
+ReleaseS3Context (
+  IN S3_CONTEXT  *S3Context
+  )
+{
+  FreePool (S3Context);
+}
+
+EFI_STATUS
+SaveCondensedWritePointerToS3Context (
+  IN OUT S3_CONTEXT  *S3Context,
+  IN     UINT16      PointerItem,
+  IN     UINT8       PointerSize,
+  IN     UINT32      PointerOffset,
+  IN     UINT64      PointerValue
+  )
+{
+  HOST_S3_WRITE  *Write;
+
+  if (S3Context->Used == S3Context->Capacity) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Write         = &S3Context->Writes[S3Context->Used++];
+  Write->Item   = PointerItem;
+  Write->Size   = PointerSize;
+  Write->Offset = PointerOffset;
+  Write->Value  = PointerValue;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+TransferS3ContextToBootScript (
+  IN S3_CONTEXT  *S3Context
+  )
+{
+  assert (S3Context->Used <= HOST_MAX_S3_WRITES);
+  gHostS3WriteCount = S3Context->Used;
+  memcpy (gHostS3Writes, S3Context->Writes, S3Context->Used * sizeof (HOST_S3_WRITE));
+  FreePool (S3Context);
+  return EFI_SUCCESS;
+}
+
+//
+// EFI_ACPI_TABLE_PROTOCOL.
+//
+STATIC
+EFI_STATUS
+EFIAPI
+HostInstallAcpiTable (
+  IN  EFI_ACPI_TABLE_PROTOCOL  *This,
+  IN  VOID                     *AcpiTableBuffer,
+  IN  UINTN                    AcpiTableBufferSize,
+  OUT UINTN                    *TableKey
+  )
+{
+  HOST_TABLE  *Table;
+
+  gHost.InstallCalls++;
+  if ((gHost.FailInstallAfter >= 0) && (gHost.FailInstallAfter-- == 0)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  assert (gHostTableCount < HOST_MAX_TABLES);
+  Table       = &gHostTables[gHostTableCount];
+  Table->Data = malloc (AcpiTableBufferSize);
+  memcpy (Table->Data, AcpiTableBuffer, AcpiTableBufferSize);
+  Table->Size = AcpiTableBufferSize;
+  Table->Key  = 1000 + gHostTableCount;
+  Table->Live = TRUE;
+  memcpy (Table->Signature, AcpiTableBuffer, 4);
+  Table->Signature[4] = '\0';
+
+  *TableKey = Table->Key;
+  ++gHostTableCount;
+  gHost.XsdtRebuilds++;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+HostUninstallAcpiTable (
+  IN EFI_ACPI_TABLE_PROTOCOL  *This,
+  IN UINTN                    TableKey
+  )
+{
+  UINTN  Index;
+
+  gHost.UninstallCalls++;
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    if ((gHostTables[Index].Key == TableKey) && gHostTables[Index].Live) {
+      gHostTables[Index].Live = FALSE;
+      gHost.XsdtRebuilds++;
+      return EFI_SUCCESS;
+    }
+  }
+
+  fprintf (stderr, "UninstallAcpiTable: unknown key %lu\n", (unsigned long)TableKey);
+  abort ();
+}
+
+EFI_ACPI_TABLE_PROTOCOL  gHostAcpiTable = {
+  HostInstallAcpiTable,
+  HostUninstallAcpiTable
+};
+
+UINTN
+HostLiveTables (
+  VOID
+  )
+{
+  UINTN  Count;
+  UINTN  Index;
+
+  Count = 0;
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    Count += gHostTables[Index].Live;
+  }
+
+  return Count;
+}
+
+VOID
+HostReset (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < gHostFileCount; ++Index) {
+    free (gHostFiles[Index].Data);
+  }
+
+  for (Index = 0; Index < gHostTableCount; ++Index) {
+    free (gHostTables[Index].Data);
+  }
+
+  while (mPageCount > 0) {
+    HostFreePages (mPages[0].Address, 1);
+  }
+
+  gHostFileCount        = 0;
+  gHostTableCount       = 0;
+  gHostMeasurementCount = 0;
+  gHostS3WriteCount     = 0;
+  mSelected             = NULL;
+
+  memset (&gHost, 0, sizeof gHost);
+  gHost.FailPoolAfter    = -1;
+  gHost.FailInstallAfter = -1;
+}
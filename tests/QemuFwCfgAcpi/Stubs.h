@@ -0,0 +1,153 @@
+/** @file
+  Simulated platform for the QemuFwCfgAcpi.c host harness: an fw_cfg device
+  holding a set of named files, a page and pool allocator that keep count, a
+  TPM event log, an S3 boot script and an EFI_ACPI_TABLE_PROTOCOL instance
+  that records the tables installed through it.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef STUBS_H_
+#define STUBS_H_
+
+#include <IndustryStandard/QemuLoader.h>
+#include <Protocol/AcpiTable.h>
+
+#define HOST_MAX_FILES         4096
+#define HOST_MAX_MEASUREMENTS  4096
+#define HOST_MAX_S3_WRITES     4096
+#define HOST_MAX_TABLES        4096
+
+//
+// The fw_cfg selector of the first file; files get consecutive selectors.
+//
+#define HOST_FIRST_FILE_ITEM  0x20
+
+typedef struct {
+  CHAR8    Name[QEMU_LOADER_FNAME_SIZE];
+  UINT8    *Data;
+  UINTN    Size;
+  UINTN    Lookups;         // QemuFwCfgFindFile() calls that found it
+  UINTN    Selects;         // QemuFwCfgSelectItem() calls for it
+  UINTN    ReadBytes;       // bytes read from it
+} HOST_FILE;
+
+typedef struct {
+  UINT32    PcrIndex;
+  UINT32    EventType;
+  UINTN     Size;
+  UINT32    Crc;
+} HOST_MEASUREMENT;
+
+typedef struct {
+  UINT16    Item;
+  UINT8     Size;
+  UINT32    Offset;
+  UINT64    Value;
+} HOST_S3_WRITE;
+
+typedef struct {
+  UINT8      *Data;         // copy of the table as installed
+  UINTN      Size;
+  UINTN      Key;
+  BOOLEAN    Live;          // FALSE once uninstalled
+  CHAR8      Signature[5];
+} HOST_TABLE;
+
+typedef struct {
+  //
+  // Failure injection. A countdown of -1 never fires.
+  //
+  INTN       FailPoolAfter;
+  INTN       FailInstallAfter;
+  BOOLEAN    FailReservedPages;
+
+  BOOLEAN    S3Enabled;
+
+  //
+  // Counters, cleared by HostReset().
+  //
+  UINTN      FwCfgSelects;
+  UINTN      FwCfgReadBytes;
+  UINTN      FwCfgWrites;
+  UINTN      FindFileCalls;
+  INTN       PoolOutstanding;
+  UINTN      PoolAllocations;
+  UINTN      PoolBytes;
+  UINTN      PoolPeakBytes;
+  UINTN      PageAllocations;
+  UINTN      InstallCalls;
+  UINTN      UninstallCalls;
+  UINTN      XsdtRebuilds;    // successful installs and uninstalls, each of
+                              // which makes AcpiTableDxe rebuild the RSDT and
+                              // XSDT and recompute their checksums
+  INTN       NotifyInstalled;
+  INTN       PciDecodingDepth;
+  UINTN      S3ContextCapacity;
+} HOST_STATE;
+
+extern HOST_STATE               gHost;
+extern HOST_FILE                gHostFiles[HOST_MAX_FILES];
+extern UINTN                    gHostFileCount;
+extern HOST_MEASUREMENT         gHostMeasurements[HOST_MAX_MEASUREMENTS];
+extern UINTN                    gHostMeasurementCount;
+extern HOST_S3_WRITE            gHostS3Writes[HOST_MAX_S3_WRITES];
+extern UINTN                    gHostS3WriteCount;
+extern HOST_TABLE               gHostTables[HOST_MAX_TABLES];
+extern UINTN                    gHostTableCount;
+extern EFI_ACPI_TABLE_PROTOCOL  gHostAcpiTable;
+extern UINTN                    gHostVerbosity;
+
+/**
+  Add a file to the simulated fw_cfg device.
+
+  @param[in] Name  The fw_cfg file name.
+  @param[in] Data  The contents, or NULL for a zero-filled file.
+  @param[in] Size  The size of the file.
+
+  @return  The index of the file in gHostFiles.
+**/
+UINTN
+HostAddFile (
+  IN CONST CHAR8  *Name,
+  IN CONST VOID   *Data,
+  IN UINTN        Size
+  );
+
+/**
+  Look up a file of the simulated fw_cfg device without counting a lookup.
+
+  @return  The file, or NULL if there is no file called Name.
+**/
+HOST_FILE *
+HostFindFile (
+  IN CONST CHAR8  *Name
+  );
+
+/**
+  Count the pages currently allocated with a given memory type, or with any
+  memory type if Type is negative.
+**/
+UINTN
+HostPagesOutstanding (
+  IN INTN  Type
+  );
+
+/**
+  Count the ACPI tables that are installed and have not been uninstalled.
+**/
+UINTN
+HostLiveTables (
+  VOID
+  );
+
+/**
+  Forget all files, tables, measurements and S3 writes, free all pages, and
+  clear the counters and failure injection settings.
+**/
+VOID
+HostReset (
+  VOID
+  );
+
+#endif
@@ -0,0 +1,24 @@
+#!/bin/bash
+
+#############################################################################
+## Builds the host replay harness for QemuFwCfgAcpi.c and runs it.         ##
+##                                                                         ##
+##     tests/QemuFwCfgAcpi/run.sh [-v] [scenario...]                       ##
+##     tests/QemuFwCfgAcpi/run.sh [-v] --replay <dir> [iterations]         ##
+##     tests/QemuFwCfgAcpi/run.sh --bench [rounds]                         ##
+##                                                                         ##
+## CC and CFLAGS are honoured; the binary goes to $BUILD_DIR.              ##
+#############################################################################
+
+HERE="$(dirname "$(readlink -f "$0")")"
+REPO="$(readlink -f "$HERE/../..")"
+BUILD_DIR="${BUILD_DIR:-$HERE/build}"
+CC="${CC:-cc}"
+
+mkdir -p "$BUILD_DIR" || exit 1
+
+"$CC" -O1 -g -Wall -Werror -Wno-unused-function -Wno-unused-variable \
+    -I"$HERE/Include" -I"$HERE" -I"$REPO" $CFLAGS \
+    -o "$BUILD_DIR/Harness" "$HERE/Harness.c" "$HERE/Stubs.c" || exit 1
+
+exec "$BUILD_DIR/Harness" "$@"
@@ -0,0 +1,63 @@
+#!/bin/bash
+
+#############################################################################
+## Times get-group against the lspci-per-function loop it replaced, on a   ##
+## synthetic tree from gen-sysfs.sh:                                       ##
+##                                                                         ##
+##     tests/get-group/bench.sh [groups]                                   ##
+##                                                                         ##
+## lspci cannot read a fake tree, so the old loop runs a stub that reads   ##
+## the device's vendor and scans pci.ids once per call, as lspci does.     ##
+#############################################################################
+
+HERE="$(dirname "$(readlink -f "$0")")"
+GET_GROUP="$(readlink -f "$HERE/../../get-group")"
+GROUPS_WANTED="${1:-3000}"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+export SYSFS_ROOT="$WORK/sys"
+export PCI_IDS="$SYSFS_ROOT/pci.ids"
+
+"$HERE/gen-sysfs.sh" "$SYSFS_ROOT" "$GROUPS_WANTED"
+
+mkdir -p "$WORK/bin"
+cat >"$WORK/bin/lspci" <<'STUB'
+#!/bin/bash
+dev="$SYSFS_ROOT/bus/pci/devices/$2"
+read -r vendor <"$dev/vendor"
+read -r device <"$dev/device"
+awk -v v="${vendor#0x}" -v d="${device#0x}" -v addr="${2#0000:}" '
+    /^[0-9a-f]/ { cur = substr($0, 1, 4); if (cur == v) name = substr($0, 7) }
+    /^\t[0-9a-f]/ && cur == v && substr($0, 2, 4) == d { name = name " " substr($0, 8) }
+    END { print addr " " name " [" v ":" d "]" }' "$PCI_IDS"
+STUB
+chmod +x "$WORK/bin/lspci"
+
+## The loop get-group used to be ##
+function old_get_group {
+    local g d
+
+    for g in "$SYSFS_ROOT"/kernel/iommu_groups/*; do
+        echo "IOMMU Group ${g##*/}:"
+        for d in "$g"/devices/*; do
+            echo -e "\t$(lspci -nns "${d##*/}")"
+        done
+    done
+}
+
+## Prints the wall time of "$@" in seconds ##
+function wall {
+    local start end
+
+    start=$(date +%s%N)
+    "$@" >/dev/null
+    end=$(date +%s%N)
+    printf '%d.%02d' $(( (end - start) / 1000000000 )) $(( (end - start) / 10000000 % 100 ))
+}
+
+echo "$GROUPS_WANTED groups, $(ls "$SYSFS_ROOT/bus/pci/devices" | wc -l) functions"
+echo "  old loop (lspci per function)  $(PATH="$WORK/bin:$PATH" wall old_get_group) s"
+echo "  get-group                      $(wall "$GET_GROUP") s"
+echo "  get-group -v -j                $(wall "$GET_GROUP" -v -j) s"
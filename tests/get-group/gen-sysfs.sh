@@ -0,0 +1,105 @@
+#!/bin/bash
+
+#############################################################################
+## Builds a synthetic sysfs tree for get-group:                            ##
+##                                                                         ##
+##     tests/get-group/gen-sysfs.sh <root> [groups]                        ##
+##                                                                         ##
+## Groups 1 and 2 hold a fixed set of functions that the tests look at:    ##
+##     group 1  00:01.0 root port (ACS), 01:00.0 GPU, 01:00.1 its audio    ##
+##     group 2  00:14.0 USB controller                                     ##
+## Groups 3 and up (to <groups>, default 2) hold one filler function       ##
+## each. NUMA node 0 has CPUs 0-3 and node 1 CPUs 4-7. <root>/pci.ids      ##
+## names the fixed functions and is padded with filler vendors to about    ##
+## the size of the real database.                                          ##
+#############################################################################
+
+ROOT="$1"
+GROUPS_WANTED="${2:-2}"
+
+if [[ -z $ROOT ]]; then
+    echo "Usage: ${0##*/} <root> [groups]" >&2
+    exit 2
+fi
+
+## Writes the little-endian dword $3 at offset $2 of the config file $1 ##
+function config_dword {
+    printf "\\x$(printf %02x $(( $3 & 255 )))\\x$(printf %02x $(( ($3 >> 8) & 255 )))\\x$(printf %02x $(( ($3 >> 16) & 255 )))\\x$(printf %02x $(( $3 >> 24 )))" |
+        dd of="$1" bs=1 seek="$2" conv=notrunc status=none
+}
+
+## Extended capability header: id, version 1, offset of the next one ##
+function ext_cap {
+    echo $(( $1 | (1 << 16) | ($2 << 20) ))
+}
+
+## mk <group> <address> <vendor> <device> <class> <rev> <driver> <numa> <reset_method> <config size> ##
+function mk {
+    local dev="$ROOT/bus/pci/devices/$2"
+
+    mkdir -p "$dev" "$ROOT/kernel/iommu_groups/$1/devices"
+    echo "0x$3" >"$dev/vendor"
+    echo "0x$4" >"$dev/device"
+    echo "0x$5" >"$dev/class"
+    echo "0x$6" >"$dev/revision"
+    echo "$8" >"$dev/numa_node"
+    echo "PCI_CLASS=$5" >"$dev/uevent"
+    if [[ -n $7 ]]; then
+        echo "DRIVER=$7" >>"$dev/uevent"
+    fi
+    if [[ -n $9 ]]; then
+        echo "$9" >"$dev/reset_method"
+        : >"$dev/reset"
+    fi
+    head -c "${10}" /dev/zero >"$dev/config"
+    ln -s "../../../../bus/pci/devices/$2" "$ROOT/kernel/iommu_groups/$1/devices/$2"
+}
+
+rm -rf "$ROOT"
+mkdir -p "$ROOT/kernel/iommu_groups" "$ROOT/bus/pci/devices"
+
+mk 1 0000:00:01.0 8086 1901 060400 07 pcieport 0 "" 4096
+mk 1 0000:01:00.0 10de 2484 030000 a1 nvidia 0 "flr bus" 4096
+mk 1 0000:01:00.1 10de 228b 040300 a1 snd_hda_intel 0 "flr bus" 256
+mk 2 0000:00:14.0 8086 a2af 0c0330 00 xhci_hcd -1 "flr" 256
+
+## The root port has AER then ACS, the GPU only AER ##
+config_dword "$ROOT/bus/pci/devices/0000:00:01.0/config" 256 "$(ext_cap 1 0x148)"
+config_dword "$ROOT/bus/pci/devices/0000:00:01.0/config" 328 "$(ext_cap 13 0)"
+config_dword "$ROOT/bus/pci/devices/0000:01:00.0/config" 256 "$(ext_cap 1 0)"
+
+mkdir -p "$ROOT/devices/system/node/node0" "$ROOT/devices/system/node/node1"
+echo "0-3" >"$ROOT/devices/system/node/node0/cpulist"
+echo "4-7" >"$ROOT/devices/system/node/node1/cpulist"
+
+for ((g = 3; g <= GROUPS_WANTED; g++)); do
+    mk "$g" "$(printf '0000:%02x:%02x.%x' $(( g / 256 + 2 )) $(( g / 8 % 32 )) $(( g % 8 )))" \
+        abcd 1234 ff0000 00 "" 1 "bus" 256
+done
+
+{
+    echo "# Synthetic pci.ids for get-group tests"
+    printf '10de  NVIDIA Corporation\n'
+    printf '\t2484  GA104 [GeForce RTX 3070]\n'
+    printf '\t\t1043 87b8  TUF RTX 3070\n'
+    printf '\t228b  GA104 High Definition Audio Controller\n'
+    printf '8086  Intel Corporation\n'
+    printf '\t1901  6th-10th Gen Core Processor PCIe Controller (x16)\n'
+    printf '\ta2af  200 Series/Z370 Chipset Family USB 3.0 xHCI Controller\n'
+    awk 'BEGIN {
+        for (v = 0; v < 1800; v++) {
+            printf "f%03x  Filler Vendor %d\n", v, v
+            for (d = 0; d < 18; d++)
+                printf "\t%04x  Filler Device %d\n", d, d
+        }
+    }'
+    echo
+    printf 'C 03  Display controller\n'
+    printf '\t00  VGA compatible controller\n'
+    printf 'C 04  Multimedia controller\n'
+    printf '\t03  Audio device\n'
+    printf 'C 06  Bridge\n'
+    printf '\t04  PCI bridge\n'
+    printf 'C 0c  Serial bus controller\n'
+    printf '\t03  USB controller\n'
+} >"$ROOT/pci.ids"
@@ -0,0 +1,114 @@
+#!/bin/bash
+
+#############################################################################
+## Runs get-group against a synthetic sysfs tree from gen-sysfs.sh and     ##
+## checks its text, verbose and JSON output, and --check against the       ##
+## domain XMLs next to this file.                                          ##
+#############################################################################
+
+HERE="$(dirname "$(readlink -f "$0")")"
+GET_GROUP="$(readlink -f "$HERE/../../get-group")"
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+FAILED=0
+
+export SYSFS_ROOT="$WORK/sys"
+export PCI_IDS="$SYSFS_ROOT/pci.ids"
+
+## Runs the command in $2... and reports it under the description in $1 ##
+function check {
+    local desc="$1"
+    shift
+
+    if "$@"; then
+        echo "  ok   $desc"
+    else
+        echo "  FAIL $desc"
+        FAILED=1
+    fi
+}
+
+## The output in $1 has the exact line $2 ##
+function has_line {
+    grep -q -x -F -- "$2" <<<"$1"
+}
+
+"$HERE/gen-sysfs.sh" "$SYSFS_ROOT" 12
+
+echo "inventory"
+output=$("$GET_GROUP")
+check "succeeds" [ $? = 0 ]
+check "lists the GPU like lspci -nns" \
+    has_line "$output" $'\t01:00.0 VGA compatible controller [0300]: NVIDIA Corporation GA104 [GeForce RTX 3070] [10de:2484] (rev a1)'
+check "leaves out a zero revision" \
+    has_line "$output" $'\t00:14.0 USB controller [0c03]: Intel Corporation 200 Series/Z370 Chipset Family USB 3.0 xHCI Controller [8086:a2af]'
+check "falls back to the class and Device for unknown IDs" \
+    has_line "$output" $'\t02:00.3 Class [ff00]: Device [abcd:1234]'
+check "orders groups numerically" \
+    [ "$(grep '^IOMMU' <<<"$output" | tr -dc '0-9\n' | tr '\n' ' ')" = "1 2 3 4 5 6 7 8 9 10 11 12 " ]
+
+echo "verbose"
+output=$("$GET_GROUP" -v)
+check "shows driver, NUMA node and reset methods" \
+    grep -q $'^\t\tdriver: nvidia  numa: 0  reset: flr bus  acs: ' <<<"$output"
+check "shows none for a function without driver or reset_method" \
+    grep -q $'^\t\tdriver: pcieport  numa: 0  reset: none  acs: ' <<<"$output"
+
+if (( EUID == 0 )); then
+    ## A config file od cannot read must not shift the bytes of the next one ##
+    mv "$SYSFS_ROOT/bus/pci/devices/0000:01:00.0/config" "$WORK/config"
+    mkdir "$SYSFS_ROOT/bus/pci/devices/0000:01:00.0/config"
+    output=$("$GET_GROUP" -v)
+    check "finds ACS on the root port" \
+        eval 'grep -A1 "00:01.0 " <<<"$output" | grep -q "acs: yes$"'
+    check "reports ACS as unknown for an unreadable config" \
+        eval 'grep -A1 "01:00.0 " <<<"$output" | grep -q "acs: ?$"'
+    check "reads the next function on its own" \
+        eval 'grep -A1 "01:00.1 " <<<"$output" | grep -q "acs: no$"'
+    rmdir "$SYSFS_ROOT/bus/pci/devices/0000:01:00.0/config"
+    mv "$WORK/config" "$SYSFS_ROOT/bus/pci/devices/0000:01:00.0/config"
+else
+    echo "  skip ACS checks, they need root"
+fi
+
+echo "json"
+output=$("$GET_GROUP" -j -v)
+check "succeeds" [ $? = 0 ]
+check "has one entry per group" [ "$(grep -c '"group": ' <<<"$output")" = 12 ]
+check "has the GPU fields" \
+    grep -q -F '{"address": "0000:01:00.0", "vendor": "10de", "device": "2484", "class": "0300", "revision": "a1",' <<<"$output"
+check "uses null for a missing driver" grep -q -F '"driver": null, "numa_node": 1,' <<<"$output"
+if command -v python3 >/dev/null; then
+    check "parses as JSON" python3 -c 'import json, sys; json.load(sys.stdin)' <<<"$output"
+fi
+
+echo "check"
+output=$("$GET_GROUP" --check "$HERE/pass.xml")
+check "passes the GPU with its audio function" [ $? = 0 ]
+check "reports the group" [ "$output" = "IOMMU Group 1: PASS" ]
+output=$("$GET_GROUP" --check "$HERE/fail.xml")
+check "fails a group left half on the host" [ $? = 1 ]
+check "names the function left behind" \
+    has_line "$output" $'\t0000:01:00.1 (Audio device) is in the group but not passed through'
+check "names the NUMA mismatch" \
+    has_line "$output" $'\t0000:01:00.0 is on NUMA node 0 but the vCPUs are pinned to node 1'
+check "fails a hostdev that is not on the host" has_line "$output" "Device 0000:09:00.0: FAIL"
+check "accepts --check after other options" \
+    eval '[ "$("$GET_GROUP" -v --check "$HERE/fail.xml")" = "$output" ]'
+check "accepts --check=<file>" \
+    eval '[ "$("$GET_GROUP" --check="$HERE/fail.xml")" = "$output" ]'
+output=$("$GET_GROUP" -j --check "$HERE/fail.xml")
+check "fails as JSON after -j" [ $? = 1 ]
+check "reports the group as JSON" grep -q -F '{"group": 1, "pass": false, "problems": [' <<<"$output"
+if command -v python3 >/dev/null; then
+    check "parses as JSON" python3 -c 'import json, sys; json.load(sys.stdin)' <<<"$output"
+fi
+
+if [ "$FAILED" = 0 ]; then
+    echo "ALL PASS"
+else
+    echo "SOME FAILED"
+fi
+exit "$FAILED"
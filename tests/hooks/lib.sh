@@ -0,0 +1,29 @@
+#!/bin/bash
+
+#############################################################################
+## Helpers shared by the test-*.sh files. Source it first.                 ##
+#############################################################################
+
+HOOKS="$(readlink -f "$(dirname "${BASH_SOURCE[0]}")/../../hooks")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+FAILED=0
+DATE="test:"
+
+## Runs the command in $2... and reports it under the description in $1 ##
+function check {
+    local desc="$1"
+    shift
+
+    if "$@"; then
+        echo "  ok   $desc"
+    else
+        echo "  FAIL $desc"
+        FAILED=1
+    fi
+}
+
+function finish {
+    exit "$FAILED"
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+#############################################################################
+## Runs the hook helper tests against fake sysfs trees and stub tools.     ##
+##                                                                         ##
+##     tests/hooks/run.sh [test...]                                        ##
+##                                                                         ##
+## A test is one of the test-*.sh files here, named without the prefix     ##
+## and suffix (e.g. "modules"). Without arguments all of them run.         ##
+#############################################################################
+
+HERE="$(dirname "$(readlink -f "$0")")"
+STATUS=0
+
+for test in "$HERE"/test-*.sh; do
+    name="$(basename "$test" .sh)"
+    name="${name#test-}"
+    if (( $# > 0 )) && [[ " $* " != *" $name "* ]]; then
+        continue
+    fi
+
+    echo "$name"
+    bash "$test" || STATUS=1
+done
+
+if [ "$STATUS" = 0 ]; then
+    echo "ALL PASS"
+else
+    echo "SOME FAILED"
+fi
+exit "$STATUS"
@@ -0,0 +1,122 @@
+#!/bin/bash
+
+#############################################################################
+## Tests for hooks/vfio-devices.sh, with a fake /sys/bus/pci. The kernel   ##
+## side of a bind or probe is played by the test: it relinks the driver    ##
+## of each device and checks what the helper wrote to the sysfs files.     ##
+#############################################################################
+
+source "$(dirname "$(readlink -f "$0")")/lib.sh"
+
+SYSFS_PCI_ROOT="$WORK/pci"
+VFIO_DEVICE_STATE="$WORK/state"
+
+source "$HOOKS/vfio-modules.sh"
+source "$HOOKS/vfio-devices.sh"
+
+GPU=0000:01:00.0
+AUDIO=0000:01:00.1
+
+## Resets the tree; each argument is address=driver, with an empty driver for none ##
+function fake_pci {
+    local arg addr driver
+
+    rm -rf "$SYSFS_PCI_ROOT" "$VFIO_DEVICE_STATE"
+    mkdir -p "$SYSFS_PCI_ROOT/devices" "$SYSFS_PCI_ROOT/drivers"
+    : >"$SYSFS_PCI_ROOT/drivers_probe"
+    for driver in nvidia snd_hda_intel vfio-pci; do
+        mkdir -p "$SYSFS_PCI_ROOT/drivers/$driver"
+        : >"$SYSFS_PCI_ROOT/drivers/$driver/unbind"
+    done
+    for arg in "$@"; do
+        addr="${arg%%=*}"
+        mkdir -p "$SYSFS_PCI_ROOT/devices/$addr"
+        : >"$SYSFS_PCI_ROOT/devices/$addr/driver_override"
+        set_driver "$addr" "${arg#*=}"
+    done
+}
+
+## What the kernel does when a device is bound or unbound ##
+function set_driver {
+    rm -f "$SYSFS_PCI_ROOT/devices/$1/driver"
+    if [[ -n $2 ]]; then
+        ln -s "../../drivers/$2" "$SYSFS_PCI_ROOT/devices/$1/driver"
+    fi
+}
+
+## The last write to the sysfs file $1 (relative to the root) was $2, ##
+## or there was none if $2 is missing. Unlike sysfs, a plain file only ##
+## keeps the last write, so each case below moves as few devices as   ##
+## it needs to tell the writes apart.                                  ##
+function holds {
+    [[ $(cat "$SYSFS_PCI_ROOT/$1") == "${2:-}" ]]
+}
+
+cat >"$WORK/domain.xml" <<'XML'
+<domain>
+    <hostdev mode="subsystem" type="pci" managed="no">
+      <source>
+        <address domain="0x0000" bus="0x01" slot="0x00" function="0x0"/>
+      </source>
+      <address type="pci" domain="0x0000" bus="0x05" slot="0x00" function="0x0"/>
+    </hostdev>
+    <hostdev mode='subsystem' type='pci' managed='no'>
+      <source>
+        <address domain='0' bus='0x1' slot='0x0' function='0x1'/>
+      </source>
+    </hostdev>
+    <hostdev mode='subsystem' type='usb'>
+      <source><address bus='1' device='2'/></source>
+    </hostdev>
+</domain>
+XML
+
+echo "  domain XML"
+check "lists the PCI hostdev sources only" \
+    [ "$(vfio_domain_hostdevs "$WORK/domain.xml")" = "$GPU"$'\n'"$AUDIO" ]
+
+echo "  bind"
+fake_pci "$GPU=nvidia" "$AUDIO="
+output=$(vfio_devices_bind $(vfio_domain_hostdevs "$WORK/domain.xml") 0000:02:00.0)
+check "records the previous drivers" \
+    [ "$(cat "$VFIO_DEVICE_STATE")" = "$GPU nvidia"$'\n'"$AUDIO -" ]
+check "sets the override on both" \
+    eval 'holds devices/$GPU/driver_override vfio-pci && holds devices/$AUDIO/driver_override vfio-pci'
+check "unbinds nvidia from the GPU" holds drivers/nvidia/unbind "$GPU"
+check "reprobes the device with no driver too" holds drivers_probe "$AUDIO"
+check "skips a missing device" grep -q "Device 0000:02:00.0 not found" <<<"$output"
+
+echo "  release while on vfio-pci"
+set_driver "$GPU" vfio-pci
+set_driver "$AUDIO" vfio-pci
+: >"$SYSFS_PCI_ROOT/drivers_probe"
+output=$(vfio_devices_release)
+check "clears the overrides" \
+    eval 'holds devices/$GPU/driver_override && holds devices/$AUDIO/driver_override'
+check "unbinds from vfio-pci" holds drivers/vfio-pci/unbind "$AUDIO"
+check "reprobes only the device that had a driver" holds drivers_probe "$GPU"
+check "removes the state file" [ ! -e "$VFIO_DEVICE_STATE" ]
+
+echo "  release with one device given back already"
+fake_pci "$GPU=vfio-pci" "$AUDIO=snd_hda_intel"
+printf '%s\n' "$GPU nvidia" "$AUDIO snd_hda_intel" >"$VFIO_DEVICE_STATE"
+output=$(vfio_devices_release)
+check "unbinds the GPU from vfio-pci" holds drivers/vfio-pci/unbind "$GPU"
+check "leaves the audio function on snd_hda_intel" holds drivers/snd_hda_intel/unbind
+check "reprobes only the GPU" holds drivers_probe "$GPU"
+
+echo "  release after libvirt gave the devices back"
+fake_pci "$GPU=nvidia" "$AUDIO=snd_hda_intel"
+printf '%s\n' "$GPU nvidia" "$AUDIO snd_hda_intel" >"$VFIO_DEVICE_STATE"
+echo vfio-pci >"$SYSFS_PCI_ROOT/devices/$GPU/driver_override"
+echo vfio-pci >"$SYSFS_PCI_ROOT/devices/$AUDIO/driver_override"
+output=$(vfio_devices_release)
+check "clears the overrides" \
+    eval 'holds devices/$GPU/driver_override && holds devices/$AUDIO/driver_override'
+check "unbinds nothing" \
+    eval 'holds drivers/nvidia/unbind && holds drivers/snd_hda_intel/unbind && holds drivers/vfio-pci/unbind'
+check "reprobes nothing" holds drivers_probe
+check "reports the device as already returned" grep -q "Device $GPU is already on nvidia" <<<"$output"
+check "removes the state file" [ ! -e "$VFIO_DEVICE_STATE" ]
+
+finish
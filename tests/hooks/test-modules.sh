@@ -0,0 +1,174 @@
+#!/bin/bash
+
+#############################################################################
+## Tests for hooks/vfio-modules.sh, with a fake /sys/module, a fake        ##
+## modules.dep and modules.builtin, and a stub modprobe that logs when     ##
+## each call starts and ends.                                              ##
+#############################################################################
+
+source "$(dirname "$(readlink -f "$0")")/lib.sh"
+
+SYSFS_MODULE_ROOT="$WORK/sys"
+MODULES_DEP="$WORK/modules.dep"
+MODULES_BUILTIN="$WORK/modules.builtin"
+MODPROBE="$WORK/modprobe"
+LOG="$WORK/log"
+
+cat >"$MODULES_DEP" <<'DEP'
+kernel/drivers/gpu/drm/drm.ko.zst:
+kernel/drivers/gpu/drm/drm_kms_helper.ko.zst: kernel/drivers/gpu/drm/drm.ko.zst
+kernel/drivers/gpu/drm/ttm/ttm.ko.zst: kernel/drivers/gpu/drm/drm.ko.zst
+kernel/drivers/gpu/drm/amd/amdgpu/amdgpu.ko.zst: kernel/drivers/gpu/drm/ttm/ttm.ko.zst kernel/drivers/gpu/drm/drm_kms_helper.ko.zst kernel/drivers/gpu/drm/drm.ko.zst
+kernel/drivers/gpu/drm/radeon/radeon.ko.zst: kernel/drivers/gpu/drm/ttm/ttm.ko.zst kernel/drivers/gpu/drm/drm_kms_helper.ko.zst kernel/drivers/gpu/drm/drm.ko.zst
+kernel/drivers/i2c/busses/i2c-nvidia-gpu.ko.zst:
+kernel/drivers/vfio/vfio.ko.zst:
+kernel/drivers/vfio/vfio_iommu_type1.ko.zst: kernel/drivers/vfio/vfio.ko.zst
+kernel/drivers/vfio/pci/vfio-pci.ko.zst: kernel/drivers/vfio/vfio.ko.zst
+updates/nvidia.ko:
+updates/nvidia-modeset.ko: updates/nvidia.ko
+updates/nvidia-drm.ko: updates/nvidia-modeset.ko updates/nvidia.ko kernel/drivers/gpu/drm/drm_kms_helper.ko.zst kernel/drivers/gpu/drm/drm.ko.zst
+updates/nvidia-uvm.ko: updates/nvidia.ko
+DEP
+
+## Takes long enough that parallel calls overlap in the log ##
+cat >"$MODPROBE" <<STUB
+#!/bin/bash
+if [[ \$1 == "-r" ]]; then
+    mod="\$2"
+else
+    mod="\$1"
+fi
+echo "start \$mod" >>"$LOG"
+sleep 0.2
+if [[ \$1 == "-r" ]]; then
+    rm -rf "$SYSFS_MODULE_ROOT/\$mod"
+else
+    mkdir -p "$SYSFS_MODULE_ROOT/\$mod"
+    echo 0 >"$SYSFS_MODULE_ROOT/\$mod/refcnt"
+fi
+echo "end \$mod" >>"$LOG"
+STUB
+chmod +x "$MODPROBE"
+
+source "$HOOKS/vfio-modules.sh"
+
+## Resets the tree to the given loaded modules, as name or name=refcnt ##
+function fake_modules {
+    local mod
+
+    rm -rf "$SYSFS_MODULE_ROOT" "$LOG"
+    mkdir -p "$SYSFS_MODULE_ROOT"
+    : >"$LOG"
+    : >"$MODULES_BUILTIN"
+    for mod in "$@"; do
+        mkdir -p "$SYSFS_MODULE_ROOT/${mod%%=*}"
+        if [[ $mod == *=* ]]; then
+            echo "${mod#*=}" >"$SYSFS_MODULE_ROOT/${mod%%=*}/refcnt"
+        else
+            echo 0 >"$SYSFS_MODULE_ROOT/$mod/refcnt"
+        fi
+    done
+}
+
+## Line number of "start $1" or "end $1" in the log ##
+function log_line {
+    grep -n -x "$1" "$LOG" | cut -d: -f1
+}
+
+## The modprobe for $1 ended before the one for $2 started ##
+function ran_before {
+    local end start
+
+    end=$(log_line "end $1")
+    start=$(log_line "start $2")
+    [[ -n $end && -n $start ]] && (( end < start ))
+}
+
+## The modprobe calls for $1 and $2 overlapped ##
+function ran_together {
+    (( $(log_line "start $1") < $(log_line "end $2") &&
+       $(log_line "start $2") < $(log_line "end $1") ))
+}
+
+## No two modprobe calls overlapped ##
+function ran_serially {
+    awk '/^start/ { if (++running > 1) bad = 1 } /^end/ { running-- }
+         END { exit bad }' "$LOG"
+}
+
+function not_called {
+    ! grep -q -x "start $1" "$LOG"
+}
+
+function is_loaded {
+    test -e "$SYSFS_MODULE_ROOT/$1"
+}
+
+echo "  NVIDIA unload"
+fake_modules nvidia_uvm nvidia_drm nvidia_modeset nvidia i2c_nvidia_gpu drm_kms_helper drm
+vfio_modules_unload nvidia_uvm nvidia_drm nvidia_modeset nvidia i2c_nvidia_gpu drm_kms_helper drm >/dev/null
+check "succeeds" [ $? = 0 ]
+check "runs one modprobe at a time" ran_serially
+check "nvidia_drm before nvidia_modeset" ran_before nvidia_drm nvidia_modeset
+check "nvidia_modeset before nvidia" ran_before nvidia_modeset nvidia
+check "nvidia_uvm before nvidia" ran_before nvidia_uvm nvidia
+check "nvidia_drm before drm_kms_helper" ran_before nvidia_drm drm_kms_helper
+check "drm_kms_helper before drm" ran_before drm_kms_helper drm
+check "leaves nothing loaded" [ -z "$(ls "$SYSFS_MODULE_ROOT")" ]
+
+echo "  NVIDIA load"
+fake_modules
+vfio_modules_load drm drm_kms_helper i2c-nvidia-gpu nvidia nvidia_modeset nvidia_drm nvidia_uvm >/dev/null
+check "succeeds" [ $? = 0 ]
+check "drm and i2c_nvidia_gpu in parallel" ran_together drm i2c_nvidia_gpu
+check "drm and nvidia in parallel" ran_together drm nvidia
+check "drm before drm_kms_helper" ran_before drm drm_kms_helper
+check "nvidia before nvidia_modeset" ran_before nvidia nvidia_modeset
+check "nvidia_modeset before nvidia_uvm (both need nvidia)" ran_before nvidia_modeset nvidia_uvm
+check "nvidia_modeset and drm_kms_helper before nvidia_drm" \
+    eval 'ran_before nvidia_modeset nvidia_drm && ran_before drm_kms_helper nvidia_drm'
+
+echo "  AMD load"
+fake_modules
+vfio_modules_load drm amdgpu radeon drm_kms_helper >/dev/null
+check "succeeds" [ $? = 0 ]
+check "drm_kms_helper before amdgpu" ran_before drm_kms_helper amdgpu
+check "amdgpu before radeon" ran_before amdgpu radeon
+
+echo "  AMD unload"
+fake_modules drm_kms_helper amdgpu radeon drm
+vfio_modules_unload drm_kms_helper amdgpu radeon drm >/dev/null
+check "succeeds" [ $? = 0 ]
+check "runs one modprobe at a time" ran_serially
+check "amdgpu before radeon" ran_before amdgpu radeon
+check "radeon before drm_kms_helper" ran_before radeon drm_kms_helper
+
+echo "  built-in modules"
+fake_modules
+echo "kernel/drivers/gpu/drm/drm.ko" >"$MODULES_BUILTIN"
+output=$(vfio_modules_load drm drm_kms_helper)
+check "load succeeds" [ $? = 0 ]
+check "load skips drm" not_called drm
+check "load reports drm as built in" grep -q "Module drm is built in" <<<"$output"
+check "drm_kms_helper is loaded" is_loaded drm_kms_helper
+mkdir -p "$SYSFS_MODULE_ROOT/drm/parameters"
+vfio_modules_unload drm_kms_helper drm >/dev/null
+check "unload succeeds" [ $? = 0 ]
+check "unload skips drm" not_called drm
+
+echo "  module in use"
+fake_modules nvidia=2
+output=$(vfio_modules_unload nvidia)
+check "unload fails" [ $? = 1 ]
+check "nvidia stays loaded" is_loaded nvidia
+check "nvidia is reported in use" grep -q "Module nvidia is in use (refcnt 2)" <<<"$output"
+check "modprobe is not called" not_called nvidia
+
+echo "  no modules.dep"
+fake_modules
+MODULES_DEP="$WORK/missing" vfio_modules_load vfio_iommu_type1 vfio vfio_pci >/dev/null
+check "succeeds" [ $? = 0 ]
+check "runs one modprobe at a time" ran_serially
+check "keeps the order given" eval 'ran_before vfio_iommu_type1 vfio && ran_before vfio vfio_pci'
+
+finish
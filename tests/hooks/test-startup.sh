@@ -0,0 +1,124 @@
+#!/bin/bash
+
+#############################################################################
+## Tests for the display manager stop in hooks/vfio-startup.sh. The whole  ##
+## script runs against a fake tree under HOOK_ROOT, with stub systemctl,   ##
+## pgrep, lspci and modprobe first in PATH. The systemctl stub logs its    ##
+## calls, and its stop job succeeds, fails or hangs as the case needs.     ##
+#############################################################################
+
+source "$(dirname "$(readlink -f "$0")")/lib.sh"
+
+export HOOK_ROOT="$WORK/root"
+export SYSFS_MODULE_ROOT="$WORK/sys/module"
+export MODULES_DEP="$WORK/modules.dep"
+export MODULES_BUILTIN="$WORK/modules.builtin"
+export MODPROBE="$WORK/bin/modprobe"
+export DM_STOP_TIMEOUT=1
+export PATH="$WORK/bin:$PATH"
+LOG="$WORK/log"
+
+mkdir -p "$WORK/bin"
+cat >"$MODULES_DEP" <<'DEP'
+kernel/drivers/vfio/vfio.ko.zst:
+kernel/drivers/vfio/vfio_iommu_type1.ko.zst: kernel/drivers/vfio/vfio.ko.zst
+kernel/drivers/vfio/pci/vfio-pci.ko.zst: kernel/drivers/vfio/vfio.ko.zst
+DEP
+: >"$MODULES_BUILTIN"
+
+## STOP_RESULT picks what a stop job does: ok, fail or hang ##
+cat >"$WORK/bin/systemctl" <<STUB
+#!/bin/bash
+echo "\$*" >>"$LOG"
+case "\$1" in
+    stop)
+        case "\$STOP_RESULT" in
+            fail) exit 1 ;;
+            hang) sleep 5 ;;
+        esac
+        ;;
+esac
+exit 0
+STUB
+
+## KDE picks whether plasmashell is running ##
+cat >"$WORK/bin/pgrep" <<'STUB'
+#!/bin/bash
+[[ -n $KDE ]] && echo "1234 plasmashell"
+STUB
+
+## No GPU, so no host driver is unloaded ##
+cat >"$WORK/bin/lspci" <<'STUB'
+#!/bin/bash
+exit 0
+STUB
+
+cat >"$MODPROBE" <<STUB
+#!/bin/bash
+echo "modprobe \$*" >>"$LOG"
+mkdir -p "$SYSFS_MODULE_ROOT/\${1//-/_}"
+echo 0 >"$SYSFS_MODULE_ROOT/\${1//-/_}/refcnt"
+STUB
+chmod +x "$WORK/bin"/*
+
+## Resets the fake tree and runs the script with the environment in $@ ##
+function startup {
+    rm -rf "$HOOK_ROOT" "$SYSFS_MODULE_ROOT" "$LOG"
+    mkdir -p "$HOOK_ROOT/run/systemd/system" "$HOOK_ROOT/etc/systemd/system" \
+        "$HOOK_ROOT/tmp" "$HOOK_ROOT/sys/class/vtconsole/vtcon0" "$SYSFS_MODULE_ROOT"
+    echo "ExecStart=/usr/bin/sddm" >"$HOOK_ROOT/etc/systemd/system/display-manager.service"
+    echo "(M) frame buffer device" >"$HOOK_ROOT/sys/class/vtconsole/vtcon0/name"
+    echo 1 >"$HOOK_ROOT/sys/class/vtconsole/vtcon0/bind"
+    : >"$LOG"
+    env "$@" bash "$HOOKS/vfio-startup.sh" 2>&1
+}
+
+function called {
+    grep -q -x -F "$1" "$LOG"
+}
+
+function loaded_vfio {
+    grep -q "^modprobe vfio" "$LOG"
+}
+
+function console_bound {
+    [ "$(cat "$HOOK_ROOT/sys/class/vtconsole/vtcon0/bind")" = 1 ]
+}
+
+echo "  stop succeeds"
+output=$(startup STOP_RESULT=ok)
+check "succeeds" [ $? = 0 ]
+check "stops the display manager" called "stop sddm.service"
+check "isolates multi-user.target" called "isolate multi-user.target"
+check "records it for the teardown" grep -q -x sddm "$HOOK_ROOT/tmp/vfio-store-display-manager"
+check "unbinds the console" eval '! console_bound'
+check "loads vfio" loaded_vfio
+check "logs the stage time" grep -q "Stage display-manager took [0-9]* ms" <<<"$output"
+
+echo "  stop fails"
+output=$(startup STOP_RESULT=fail)
+check "fails" [ $? = 1 ]
+check "reports the status" grep -q "systemctl stop sddm.service failed with status 1" <<<"$output"
+check "aborts" grep -q "Display manager did not stop, aborting startup" <<<"$output"
+check "does not isolate" eval '! called "isolate multi-user.target"'
+check "leaves the console bound" console_bound
+check "loads nothing" eval '! loaded_vfio'
+
+echo "  stop times out"
+start=$(date +%s)
+output=$(startup STOP_RESULT=hang)
+check "fails" [ $? = 1 ]
+check "gives up after DM_STOP_TIMEOUT" [ $(( $(date +%s) - start )) -lt 4 ]
+check "reports the timeout" grep -q "Timed out after 1s waiting for systemctl stop sddm.service" <<<"$output"
+check "aborts" grep -q "Display manager did not stop, aborting startup" <<<"$output"
+check "does not isolate" eval '! called "isolate multi-user.target"'
+check "loads nothing" eval '! loaded_vfio'
+
+echo "  KDE stop times out"
+output=$(startup STOP_RESULT=hang KDE=1)
+check "fails" [ $? = 1 ]
+check "stops display-manager.service" called "stop display-manager.service"
+check "aborts" grep -q "Display manager did not stop, aborting startup" <<<"$output"
+check "loads nothing" eval '! loaded_vfio'
+
+finish